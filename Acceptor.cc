@@ -4,6 +4,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include "Logger.h"
 #include "InetAddress.h"
 
@@ -21,10 +22,15 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     : loop_(loop),
       acceptSocket_(createNonblocking()),
       acceptChannel_(loop, acceptSocket_.fd()),
-      listenning_(false)
+      listenning_(false),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      maxAcceptsPerWakeup_(kDefaultMaxAcceptsPerWakeup),
+      wakeups_(0),
+      accepted_(0),
+      dropped_(0)
 {
   acceptSocket_.setReuseAddr(true);
-  acceptSocket_.setReusePort(true);
+  acceptSocket_.setReusePort(reuseport);
   acceptSocket_.bindAddress(listenAddr);
 
   acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
@@ -34,29 +40,83 @@ Acceptor::~Acceptor()
 {
   acceptChannel_.disableAll();
   acceptChannel_.remove();
+  if (idleFd_ >= 0)
+  {
+    ::close(idleFd_);
+  }
+}
+
+void Acceptor::listen()
+{
+  listenning_ = true;
+  acceptSocket_.listen();
+  acceptChannel_.enableReading();
 }
 
 void Acceptor::handleRead()
 {
-  InetAddress peerAddr;
-  int connfd = acceptSocket_.accept(&peerAddr);
-  if (connfd >= 0)
+  wakeups_.store(wakeups_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  for (int i = 0; i < maxAcceptsPerWakeup_; ++i)
   {
-    if (newConnectionCallback_)
+    InetAddress peerAddr;
+    int connfd = acceptSocket_.accept(&peerAddr);
+    if (connfd >= 0)
     {
-      newConnectionCallback_(connfd, peerAddr);
+      accepted_.store(accepted_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      if (newConnectionCallback_)
+      {
+        newConnectionCallback_(connfd, peerAddr);
+      }
+      else
+      {
+        ::close(connfd);
+      }
+      continue;
     }
-    else
+
+    int savedErrno = errno;
+    if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
     {
-      ::close(connfd);
+      break;
     }
-  }
-  else
-  {
-    LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-    if (errno == EMFILE)
+    else if (savedErrno == EMFILE || savedErrno == ENFILE)
     {
       LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+      // accept先分配fd再取连接，队列空了也会报EMFILE
+      if (!dropPendingConnection())
+      {
+        break;
+      }
+    }
+    else if (savedErrno == ECONNABORTED || savedErrno == EINTR || savedErrno == EPROTO)
+    {
+      // 对端在accept之前就断开了之类，跳过这一个
+      continue;
     }
+    else
+    {
+      // ENOBUFS/ENOMEM等，这一轮先停下
+      LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+      break;
+    }
+  }
+}
+
+bool Acceptor::dropPendingConnection()
+{
+  if (idleFd_ < 0)
+  {
+    // 预留的fd被别人占用了，这次补上
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return false;
+  }
+  ::close(idleFd_);
+  int connfd = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+  if (connfd >= 0)
+  {
+    ::close(connfd);
+    dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
   }
-}
\ No newline at end of file
+  idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  return connfd >= 0;
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include <functional>
+#include <atomic>
+#include <stdint.h>
 
 #include "noncopyable.h"
 #include "Socket.h"
@@ -22,14 +24,36 @@ public:
   }
   bool listenning() const { return listenning_; }
 
+  // 每次可读事件最多accept多少个连接，剩下的留到下一轮(监听socket是水平触发)，
+  // 避免连接风暴时一直占着loop
+  void setMaxAcceptsPerWakeup(int n) { maxAcceptsPerWakeup_ = n > 0 ? n : 1; }
+
+  // 统计，loop线程写，其他线程可以读
+  uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+  uint64_t accepted() const { return accepted_.load(std::memory_order_relaxed); }
+  // fd耗尽时接受后立即关闭的连接数
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
   void listen();
+  // 见Socket::setReusePortCpuSteering
+  bool setCpuSteering(unsigned groupSize) { return acceptSocket_.setReusePortCpuSteering(groupSize); }
 
 private:
+  static const int kDefaultMaxAcceptsPerWakeup = 64;
+
   void handleRead();
+  // fd耗尽时借用预留的fd把排队的连接accept出来再关掉，对端会马上收到断开，
+  // 否则监听socket一直可读，loop会空转；没有可以丢弃的连接时返回false
+  bool dropPendingConnection();
 
   EventLoop *loop_;
   Socket acceptSocket_;
   Channel acceptChannel_;
   NewConnectionCallback newConnectionCallback_;
   bool listenning_;
+  int idleFd_;
+  int maxAcceptsPerWakeup_;
+  std::atomic<uint64_t> wakeups_;
+  std::atomic<uint64_t> accepted_;
+  std::atomic<uint64_t> dropped_;
 };
\ No newline at end of file
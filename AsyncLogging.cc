@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <chrono>
+
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include "Timestamp.h"
+
+AsyncLogging::AsyncLogging(const std::string &basename,
+                           off_t rollSize,
+                           int flushInterval)
+    : flushInterval_(flushInterval),
+      running_(false),
+      basename_(basename),
+      rollSize_(rollSize),
+      thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging"),
+      mutex_(),
+      cond_(),
+      currentBuffer_(new Buffer),
+      nextBuffer_(new Buffer),
+      buffers_()
+{
+  currentBuffer_->bzero();
+  nextBuffer_->bzero();
+  buffers_.reserve(16);
+}
+
+void AsyncLogging::append(const char *logline, int len)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (currentBuffer_->avail() > len)
+  {
+    // 绝大多数情况：只有一次memcpy
+    currentBuffer_->append(logline, len);
+  }
+  else
+  {
+    buffers_.push_back(std::move(currentBuffer_));
+
+    if (nextBuffer_)
+    {
+      currentBuffer_ = std::move(nextBuffer_);
+    }
+    else
+    {
+      // 前端写得太快，两块缓冲都用完了才分配
+      currentBuffer_.reset(new Buffer);
+    }
+    currentBuffer_->append(logline, len);
+    cond_.notify_one();
+  }
+}
+
+void AsyncLogging::threadFunc()
+{
+  LogFile output(basename_, rollSize_, false);
+  BufferPtr newBuffer1(new Buffer);
+  BufferPtr newBuffer2(new Buffer);
+  newBuffer1->bzero();
+  newBuffer2->bzero();
+  BufferVector buffersToWrite;
+  buffersToWrite.reserve(16);
+
+  while (running_)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // 有写满的缓冲或者超时都会醒来
+      if (buffers_.empty())
+      {
+        cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+      }
+      buffers_.push_back(std::move(currentBuffer_));
+      currentBuffer_ = std::move(newBuffer1);
+      buffersToWrite.swap(buffers_);
+      if (!nextBuffer_)
+      {
+        nextBuffer_ = std::move(newBuffer2);
+      }
+    }
+
+    // 临界区之外写文件
+    if (buffersToWrite.size() > 25)
+    {
+      // 堆积太多说明前端产生日志的速度远超磁盘，丢弃多余的，只保留两块
+      char buf[256];
+      snprintf(buf, sizeof buf, "Dropped log messages at %s, %zu larger buffers\n",
+               Timestamp::now().toString().c_str(),
+               buffersToWrite.size() - 2);
+      fputs(buf, stderr);
+      output.append(buf, static_cast<int>(strlen(buf)));
+      buffersToWrite.erase(buffersToWrite.begin() + 2, buffersToWrite.end());
+    }
+
+    for (const BufferPtr &buffer : buffersToWrite)
+    {
+      output.append(buffer->data(), buffer->length());
+    }
+
+    // 留下两块给newBuffer1/newBuffer2复用，其余的释放
+    if (buffersToWrite.size() > 2)
+    {
+      buffersToWrite.resize(2);
+    }
+
+    if (!newBuffer1)
+    {
+      newBuffer1 = std::move(buffersToWrite.back());
+      buffersToWrite.pop_back();
+      newBuffer1->reset();
+    }
+
+    if (!newBuffer2)
+    {
+      newBuffer2 = std::move(buffersToWrite.back());
+      buffersToWrite.pop_back();
+      newBuffer2->reset();
+    }
+
+    buffersToWrite.clear();
+    output.flush();
+  }
+
+  // 退出前把剩余的日志写完
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const BufferPtr &buffer : buffers_)
+  {
+    output.append(buffer->data(), buffer->length());
+  }
+  buffers_.clear();
+  output.append(currentBuffer_->data(), currentBuffer_->length());
+  currentBuffer_->reset();
+  output.flush();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+#include "FixedBuffer.h"
+#include "Thread.h"
+
+// 异步日志后端，双缓冲
+// 前端(各个IO线程)只把日志拷贝到内存中的大块缓冲，由单独的后台线程批量写文件
+// 前端永远不会因为磁盘IO而阻塞
+class AsyncLogging : noncopyable
+{
+public:
+  AsyncLogging(const std::string &basename,
+               off_t rollSize,
+               int flushInterval = 3);
+  ~AsyncLogging()
+  {
+    if (running_)
+    {
+      stop();
+    }
+  }
+
+  // 前端调用，线程安全
+  void append(const char *logline, int len);
+
+  void start()
+  {
+    running_ = true;
+    thread_.start();
+  }
+
+  void stop()
+  {
+    running_ = false;
+    cond_.notify_one();
+    thread_.join();
+  }
+
+private:
+  void threadFunc();
+
+  using Buffer = FixedBuffer<kLargeBuffer>;
+  using BufferPtr = std::unique_ptr<Buffer>;
+  using BufferVector = std::vector<BufferPtr>;
+
+  const int flushInterval_;
+  std::atomic_bool running_;
+  const std::string basename_;
+  const off_t rollSize_;
+  Thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  BufferPtr currentBuffer_; // 前端正在写的缓冲
+  BufferPtr nextBuffer_;    // 预备缓冲，current写满时直接换上，不用分配
+  BufferVector buffers_;    // 写满等待后台落盘的缓冲
+};
@@ -0,0 +1,188 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "Buffer.h"
+#include "BufferPool.h"
+
+// 拷贝出来的Buffer不用rhs的pool，它可能被交给别的线程，而pool只能在所属loop线程里用
+Buffer::Buffer(const Buffer &rhs)
+    : pool_(nullptr), data_(nullptr), capacity_(0), initialSize_(rhs.initialSize_),
+      readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
+{
+  if (rhs.readableBytes() > 0)
+  {
+    append(rhs.peek(), rhs.readableBytes());
+  }
+}
+
+Buffer::Buffer(Buffer &&rhs)
+    : pool_(rhs.pool_), data_(rhs.data_), capacity_(rhs.capacity_), initialSize_(rhs.initialSize_),
+      readerIndex_(rhs.readerIndex_), writerIndex_(rhs.writerIndex_)
+{
+  rhs.data_ = nullptr;
+  rhs.capacity_ = 0;
+  rhs.readerIndex_ = rhs.writerIndex_ = kCheapPrepend;
+}
+
+Buffer &Buffer::operator=(Buffer rhs)
+{
+  swap(rhs);
+  return *this;
+}
+
+void Buffer::swap(Buffer &rhs)
+{
+  std::swap(pool_, rhs.pool_);
+  std::swap(data_, rhs.data_);
+  std::swap(capacity_, rhs.capacity_);
+  std::swap(initialSize_, rhs.initialSize_);
+  std::swap(readerIndex_, rhs.readerIndex_);
+  std::swap(writerIndex_, rhs.writerIndex_);
+}
+
+void Buffer::release()
+{
+  if (data_ != nullptr)
+  {
+    if (pool_)
+    {
+      pool_->deallocate(data_, capacity_);
+    }
+    else
+    {
+      ::free(data_);
+    }
+    data_ = nullptr;
+    capacity_ = 0;
+  }
+  readerIndex_ = writerIndex_ = kCheapPrepend;
+}
+
+void Buffer::makeSpace(size_t len)
+{
+  size_t readable = readableBytes();
+  if (data_ != nullptr && writableBytes() + prependableBytes() >= len + kCheapPrepend)
+  {
+    // 空间够用，把数据挪到前面
+    std::copy(begin() + readerIndex_,
+              begin() + writerIndex_,
+              begin() + kCheapPrepend);
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = readerIndex_ + readable;
+    return;
+  }
+
+  // 换一块更大的内存，只拷贝有效数据
+  size_t want = std::max(kCheapPrepend + readable + len, kCheapPrepend + initialSize_);
+  if (data_ != nullptr)
+  {
+    // 持续增长时按倍数扩，避免反复拷贝
+    want = std::max(want, capacity_ * 2);
+  }
+  size_t newCapacity = 0;
+  char *newData;
+  if (pool_)
+  {
+    newData = pool_->allocate(want, &newCapacity);
+  }
+  else
+  {
+    newCapacity = want;
+    newData = static_cast<char *>(::malloc(want));
+  }
+  if (readable > 0)
+  {
+    memcpy(newData + kCheapPrepend, peek(), readable);
+  }
+  release();
+  data_ = newData;
+  capacity_ = newCapacity;
+  readerIndex_ = kCheapPrepend;
+  writerIndex_ = kCheapPrepend + readable;
+}
+
+// 从fd上读数据，Poller工作在LT模式
+// Buffer的大小是有限的，但是从fd上读数据时不知道最终的数据量有多大
+// 所以用readv同时读到Buffer的可写区域和栈上的64K临时空间，一次系统调用就能把socket读空
+// 每个连接的Buffer只有在真正收到大量数据时才会扩容
+ssize_t Buffer::readfd(int fd, int *saveErrno)
+{
+  char extrabuf[kExtraBufSize]; // 栈上的内存空间
+  struct iovec vec[2];
+  const size_t writable = writableBytes();
+  // 还没有分配内存时全部读进extrabuf，再按实际大小分配
+  vec[0].iov_base = writable > 0 ? begin() + writerIndex_ : extrabuf;
+  vec[0].iov_len = writable;
+  vec[1].iov_base = extrabuf;
+  vec[1].iov_len = sizeof extrabuf;
+
+  // 可写空间已经不小于64K时，就不需要再用栈上的空间了
+  const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
+  const ssize_t n = ::readv(fd, vec, iovcnt);
+  if (n < 0)
+  {
+    *saveErrno = errno;
+  }
+  else if (static_cast<size_t>(n) <= writable)
+  {
+    writerIndex_ += n;
+  }
+  else
+  {
+    // Buffer写满了(或者还没有分配)，剩下的在extrabuf里，按实际需要扩容后追加
+    writerIndex_ += writable;
+    append(extrabuf, n - writable);
+  }
+  return n;
+}
+
+// 边缘触发下使用，一直读到EAGAIN或者对端关闭
+// 返回本次读到的总字节数，出错(EAGAIN除外)且没有读到数据时返回-1
+ssize_t Buffer::readfdUntilEagain(int fd, int *saveErrno, bool *eof)
+{
+  ssize_t total = 0;
+  *eof = false;
+  for (;;)
+  {
+    int err = 0;
+    ssize_t n = readfd(fd, &err);
+    if (n > 0)
+    {
+      total += n;
+    }
+    else if (n == 0)
+    {
+      *eof = true;
+      break;
+    }
+    else if (err == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      if (err != EAGAIN && err != EWOULDBLOCK)
+      {
+        *saveErrno = err;
+        if (total == 0)
+        {
+          return -1;
+        }
+      }
+      break;
+    }
+  }
+  return total;
+}
+
+ssize_t Buffer::writeFd(int fd, int *saveErrno)
+{
+  ssize_t n = ::write(fd, peek(), readableBytes());
+  if (n < 0)
+  {
+    *saveErrno = errno;
+  }
+  return n;
+}
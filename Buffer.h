@@ -1,21 +1,46 @@
 #pragma once
 
-#include <vector>
+#include <sys/types.h>
+#include <string.h>
 #include <string>
 #include <algorithm>
 
+class BufferPool;
+
+// 内存是懒分配的：构造时不占用内存，写入数据时才从BufferPool(或者malloc)取
+// 数据全部取走之后可以调用releaseIfEmpty()把内存还回去，空闲连接不占用缓冲区
+// 扩容时直接换一块更大的内存，不会像vector::resize那样先清零
 class Buffer
 {
 public:
   // kCheapPrepend 的作用是在缓冲区的前面预留一些空间，这样在需要在缓冲区前面插入数据时，可以避免频繁的内存重新分配和数据移动操作。这种设计可以提高性能，特别是在需要频繁在缓冲区前面插入数据的场景下。
   static const size_t kCheapPrepend = 8;
   static const size_t kInitialSize = 1024;
+  // readfd时栈上临时空间的大小
+  static const size_t kExtraBufSize = 65536;
 
-  explicit Buffer(size_t initialSize = kInitialSize)
-      : buffer_(kCheapPrepend + initialSize), readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
+  // pool为空时使用malloc/free，pool的生命周期需要长于Buffer
+  explicit Buffer(size_t initialSize = kInitialSize, BufferPool *pool = nullptr)
+      : pool_(pool), data_(nullptr), capacity_(0), initialSize_(initialSize),
+        readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
   {
   }
 
+  explicit Buffer(BufferPool *pool)
+      : pool_(pool), data_(nullptr), capacity_(0), initialSize_(kInitialSize),
+        readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
+  {
+  }
+
+  // 拷贝得到的Buffer不属于任何pool，用malloc分配，可以交给其他线程
+  Buffer(const Buffer &rhs);
+  // 移动会带走pool和内存，用pool的Buffer移动之后仍然只能在pool所属的loop线程里析构
+  Buffer(Buffer &&rhs);
+  Buffer &operator=(Buffer rhs);
+  ~Buffer() { release(); }
+
+  void swap(Buffer &rhs);
+
   size_t readableBytes() const
   {
     return writerIndex_ - readerIndex_;
@@ -23,7 +48,7 @@ public:
 
   size_t writableBytes() const
   {
-    return buffer_.size() - writerIndex_;
+    return capacity_ > writerIndex_ ? capacity_ - writerIndex_ : 0;
   }
 
   size_t prependableBytes() const
@@ -31,6 +56,9 @@ public:
     return readerIndex_;
   }
 
+  // 当前占用的内存大小，没有分配时为0
+  size_t capacity() const { return capacity_; }
+
   // 返回缓冲区中可读数据的起始地址
   const char *peek() const
   {
@@ -93,38 +121,43 @@ public:
     return begin() + writerIndex_;
   }
 
+  // 没有可读数据时把内存还给pool，返回是否释放了
+  bool releaseIfEmpty()
+  {
+    if (data_ != nullptr && readableBytes() == 0)
+    {
+      release();
+      return true;
+    }
+    return false;
+  }
+
+  // 从fd上读数据，一次readv
   ssize_t readfd(int fd, int *saveErrno);
+  // 边缘触发时使用，一直读到EAGAIN，对端关闭时*eof置为true
+  ssize_t readfdUntilEagain(int fd, int *saveErrno, bool *eof);
 
   ssize_t writeFd(int fd, int *saveErrno);
 
 private:
   char *begin()
   {
-    return &*buffer_.begin();
+    return data_;
   }
 
   const char *begin() const
   {
-    return &*buffer_.begin();
+    return data_;
   }
 
-  void makeSpace(size_t len)
-  {
-    if (writableBytes() + prependableBytes() < len + kCheapPrepend)
-    {
-      buffer_.resize(writerIndex_ + len);
-    }
-    else
-    {
-      size_t readable = readableBytes();
-      std::copy(begin() + readerIndex_,
-                begin() + writerIndex_,
-                begin() + kCheapPrepend);
-      readerIndex_ = kCheapPrepend;
-      writerIndex_ = readerIndex_ + readable;
-    }
-  }
-  std::vector<char> buffer_;
+  // 释放内存，丢弃所有数据
+  void release();
+  void makeSpace(size_t len);
+
+  BufferPool *pool_;
+  char *data_;
+  size_t capacity_;
+  size_t initialSize_; // 第一次分配时的最小大小
   size_t readerIndex_;
   size_t writerIndex_;
-};
\ No newline at end of file
+};
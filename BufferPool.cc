@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <algorithm>
+
+#include "BufferPool.h"
+#include "Logger.h"
+
+const size_t BufferPool::kClassSizes[kNumClasses] = {
+    2 * 1024,
+    8 * 1024,
+    32 * 1024,
+    128 * 1024,
+    512 * 1024,
+};
+
+const size_t BufferPool::kArenaSize;
+
+// 只有不超过这个大小的块才从arena切分，大块切分会浪费arena
+static const size_t kMaxArenaBlock = 128 * 1024;
+
+BufferPool::BufferPool(bool hugePages, size_t maxCachedBytes)
+    : hugePages_(hugePages),
+      maxCachedBytes_(maxCachedBytes),
+      arenaCur_(nullptr),
+      arenaEnd_(nullptr)
+{
+  stats_.requests = 0;
+  stats_.hits = 0;
+  stats_.bytesInUse = 0;
+  stats_.bytesCached = 0;
+  stats_.arenaBytes = 0;
+}
+
+BufferPool::~BufferPool()
+{
+  if (stats_.bytesInUse != 0)
+  {
+    // 还有没归还的块，它们之后再还回来就是访问已经释放的pool
+    LOG_ERROR("BufferPool::~BufferPool %zu bytes still in use \n", stats_.bytesInUse);
+  }
+  for (int i = 0; i < kNumClasses; ++i)
+  {
+    // arena中切出来的块随arena一起释放
+    for (char *block : freeLists_[i])
+    {
+      if (!inArena(block))
+      {
+        ::free(block);
+      }
+    }
+  }
+  for (char *arena : arenas_)
+  {
+    ::munmap(arena, kArenaSize);
+  }
+}
+
+int BufferPool::classIndex(size_t size)
+{
+  for (int i = 0; i < kNumClasses; ++i)
+  {
+    if (size <= kClassSizes[i])
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+size_t BufferPool::roundUp(size_t size)
+{
+  int index = classIndex(size);
+  return index < 0 ? size : kClassSizes[index];
+}
+
+char *BufferPool::carve(size_t size)
+{
+  if (arenaCur_ == nullptr || static_cast<size_t>(arenaEnd_ - arenaCur_) < size)
+  {
+    void *arena = ::mmap(nullptr, kArenaSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (arena == MAP_FAILED)
+    {
+      // 没有预留大页时退化为透明大页
+      arena = ::mmap(nullptr, kArenaSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (arena == MAP_FAILED)
+      {
+        return nullptr;
+      }
+      ::madvise(arena, kArenaSize, MADV_HUGEPAGE);
+    }
+    // 上一个arena剩下的尾巴不足一块，直接放弃
+    char *begin = static_cast<char *>(arena);
+    arenas_.insert(std::upper_bound(arenas_.begin(), arenas_.end(), begin), begin);
+    arenaCur_ = begin;
+    arenaEnd_ = arenaCur_ + kArenaSize;
+    stats_.arenaBytes += kArenaSize;
+  }
+  char *block = arenaCur_;
+  arenaCur_ += size;
+  return block;
+}
+
+bool BufferPool::inArena(const char *data) const
+{
+  auto it = std::upper_bound(arenas_.begin(), arenas_.end(), data);
+  if (it == arenas_.begin())
+  {
+    return false;
+  }
+  --it;
+  return data < *it + kArenaSize;
+}
+
+char *BufferPool::allocate(size_t size, size_t *capacity)
+{
+  ++stats_.requests;
+  int index = classIndex(size);
+  if (index < 0)
+  {
+    // 超大块不进池子
+    *capacity = size;
+    stats_.bytesInUse += size;
+    return static_cast<char *>(::malloc(size));
+  }
+
+  size_t blockSize = kClassSizes[index];
+  *capacity = blockSize;
+  stats_.bytesInUse += blockSize;
+  std::vector<char *> &freeList = freeLists_[index];
+  if (!freeList.empty())
+  {
+    ++stats_.hits;
+    char *block = freeList.back();
+    freeList.pop_back();
+    stats_.bytesCached -= blockSize;
+    return block;
+  }
+
+  if (hugePages_ && blockSize <= kMaxArenaBlock)
+  {
+    char *block = carve(blockSize);
+    if (block)
+    {
+      return block;
+    }
+    LOG_ERROR("BufferPool::allocate mmap arena failed, fall back to malloc");
+  }
+  // malloc而不是vector::resize，不会把马上要被覆盖的内存清零
+  return static_cast<char *>(::malloc(blockSize));
+}
+
+void BufferPool::deallocate(char *data, size_t capacity)
+{
+  if (data == nullptr)
+  {
+    return;
+  }
+  stats_.bytesInUse -= capacity;
+  int index = classIndex(capacity);
+  if (index < 0 || kClassSizes[index] != capacity)
+  {
+    ::free(data);
+    return;
+  }
+
+  bool fromArena = hugePages_ && capacity <= kMaxArenaBlock && inArena(data);
+  if (!fromArena && stats_.bytesCached + capacity > maxCachedBytes_)
+  {
+    // 缓存已满，还给系统
+    ::free(data);
+    return;
+  }
+  freeLists_[index].push_back(data);
+  stats_.bytesCached += capacity;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "noncopyable.h"
+
+// 每个loop一个的缓冲区内存池，按大小分级缓存空闲块
+// Buffer和OutputQueue只在有数据时才从这里取内存，数据被取走之后立刻归还
+// 分配出去的内存不做清零
+// 可选用大页arena切分小块，减少TLB miss；大页申请失败时退化成普通页+MADV_HUGEPAGE
+// 非线程安全，只能在所属loop线程中使用
+class BufferPool : noncopyable
+{
+public:
+  // 各级块的大小，超过最大一级的直接malloc，不缓存
+  static const int kNumClasses = 5;
+  static const size_t kClassSizes[kNumClasses];
+  // arena的大小，和x86的大页一致
+  static const size_t kArenaSize = 2 * 1024 * 1024;
+
+  struct Stats
+  {
+    uint64_t requests;  // 分配次数
+    uint64_t hits;      // 从空闲链表直接拿到的次数
+    size_t bytesInUse;  // 借出去还没有归还的字节数
+    size_t bytesCached; // 空闲链表中缓存的字节数
+    size_t arenaBytes;  // 从系统申请的arena总大小
+  };
+
+  explicit BufferPool(bool hugePages = false, size_t maxCachedBytes = 32 * 1024 * 1024);
+  ~BufferPool();
+
+  // 分配至少size字节，实际大小写入*capacity
+  char *allocate(size_t size, size_t *capacity);
+  // 归还，capacity必须是allocate返回的值
+  void deallocate(char *data, size_t capacity);
+
+  // size向上取整到所在级别的大小，超出分级时原样返回
+  static size_t roundUp(size_t size);
+
+  const Stats &stats() const { return stats_; }
+  double hitRate() const
+  {
+    return stats_.requests == 0 ? 0.0 : static_cast<double>(stats_.hits) / stats_.requests;
+  }
+  bool hugePages() const { return hugePages_; }
+
+private:
+  static int classIndex(size_t size);
+  // 从arena中切出一块，arena用完时再申请一个
+  char *carve(size_t size);
+  // data是否在某个arena里；carve失败时会退回malloc，同一级的空闲链表里两种块都可能有
+  bool inArena(const char *data) const;
+
+  const bool hugePages_;
+  const size_t maxCachedBytes_;
+  std::vector<char *> freeLists_[kNumClasses];
+  std::vector<char *> arenas_; // 按地址排序
+  char *arenaCur_;
+  char *arenaEnd_;
+  Stats stats_;
+};
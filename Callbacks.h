@@ -0,0 +1,18 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+
+class Buffer;
+class TcpConnection;
+class Timestamp;
+
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
+using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
+using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
+using MessageCallback = std::function<void(const TcpConnectionPtr &, Buffer *, Timestamp)>;
+
+// 定时器到期的回调
+using TimerCallback = std::function<void()>;
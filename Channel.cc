@@ -2,11 +2,16 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "Tracer.h"
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeTriggered = EPOLLET;
 
-Channel::Channel(EventLoop *loop, int fd) : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false)
+Channel::Channel(EventLoop *loop, int fd)
+    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1),
+      tied_(false), eventHandling_(false), addedToLoop_(false),
+      edgeTriggered_(false), writing_(false)
 {
 }
 
@@ -25,15 +30,15 @@ void Channel::tie(const std::shared_ptr<void> &obj)
 void Channel::update()
 {
   // 通过所属的eventloop更新channel
-  // TODO
-  // loop_->updateChannel(this);
+  addedToLoop_ = true;
+  loop_->updateChannel(this);
 }
 
 // 在channel所属的eventloop中处理事件
 void Channel::remove()
 {
-  // TODO
-  // loop_->removeChannel(this);
+  addedToLoop_ = false;
+  loop_->removeChannel(this);
 }
 
 void Channel::handleEvent(Timestamp receiveTime)
@@ -56,24 +61,29 @@ void Channel::handleEvent(Timestamp receiveTime)
 // 事件发生时，根据revents_的值，调用相应的回调函数
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-  LOG_INFO("Channel::handleEventWithGuard() fd = %d revents = %d", fd_, revents_);
+  LOG_STREAM(DEBUG) << "Channel::handleEventWithGuard() fd = " << fd_ << " revents = " << revents_;
   if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
   {
+    TraceSpan span("close", fd_);
     if (closeCallback_)
       closeCallback_();
   }
   if (revents_ & EPOLLERR)
   {
+    TraceSpan span("error", fd_);
     if (errorCallback_)
       errorCallback_();
   }
   if (revents_ & (EPOLLIN | EPOLLPRI))
   {
+    TraceSpan span("read", fd_);
     if (readCallback_)
       readCallback_(receiveTime);
   }
-  if (revents_ & EPOLLOUT)
+  // 边沿触发时没有待发数据的可写通知直接忽略
+  if ((revents_ & EPOLLOUT) && writing_)
   {
+    TraceSpan span("write", fd_);
     if (writeCallback_)
       writeCallback_();
   }
@@ -58,10 +58,20 @@ public:
     revents_ = revt;
   }
 
+  // 边沿触发模式，必须在enableReading之前设置
+  // 此时EPOLLOUT随读事件一起常驻注册，enableWriting/disableWriting只改标志，不再调用epoll_ctl
+  // 使用者需要保证读写都做到EAGAIN为止
+  void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+  bool edgeTriggered() const { return edgeTriggered_; }
+
   // 设置fd对应的事件状态
   void enableReading()
   {
     events_ |= kReadEvent;
+    if (edgeTriggered_)
+    {
+      events_ |= kWriteEvent | kEdgeTriggered;
+    }
     update();
   }
   void disableReading()
@@ -71,23 +81,37 @@ public:
   }
   void enableWriting()
   {
-    events_ |= kWriteEvent;
-    update();
+    writing_ = true;
+    if (!(events_ & kWriteEvent))
+    {
+      events_ |= kWriteEvent;
+      if (edgeTriggered_)
+      {
+        events_ |= kEdgeTriggered;
+      }
+      update();
+    }
   }
   void disableWriting()
   {
-    events_ &= ~kWriteEvent;
-    update();
+    writing_ = false;
+    if (!edgeTriggered_)
+    {
+      events_ &= ~kWriteEvent;
+      update();
+    }
   }
   void disableAll()
   {
     events_ = kNoneEvent;
+    writing_ = false;
     update();
   }
   // 判断fd对应的事件状态
+  // 边沿触发时EPOLLOUT一直注册着，是否在等待可写以writing_为准
   bool isWriting() const
   {
-    return events_ & kWriteEvent;
+    return writing_;
   }
   bool isReading() const
   {
@@ -125,6 +149,7 @@ private:
   static const int kNoneEvent;
   static const int kReadEvent;
   static const int kWriteEvent;
+  static const int kEdgeTriggered;
 
   EventLoop *loop_;
   const int fd_; // poller 监听的对象
@@ -136,6 +161,8 @@ private:
   bool tied_;
   bool eventHandling_;
   bool addedToLoop_;
+  bool edgeTriggered_;
+  bool writing_; // 有数据等待发送，关心可写事件
 
   // 因为channel里面能够获知fd的具体事件revents，所以它需要设置相应的回调函数，他负责调用回调函数
   ReadEventCallback readCallback_;
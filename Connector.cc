@@ -0,0 +1,228 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <algorithm>
+
+const int Connector::kMaxRetryDelayMs;
+const int Connector::kInitRetryDelayMs;
+
+static int getSocketError(int sockfd)
+{
+  int optval;
+  socklen_t optlen = sizeof optval;
+  if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+  {
+    return errno;
+  }
+  return optval;
+}
+
+// 本地端口和目标端口恰好相同时，connect会连到自己身上
+static bool isSelfConnect(int sockfd)
+{
+  sockaddr_in local;
+  sockaddr_in peer;
+  socklen_t len = sizeof local;
+  ::bzero(&local, sizeof local);
+  ::bzero(&peer, sizeof peer);
+  if (::getsockname(sockfd, (sockaddr *)&local, &len) < 0)
+  {
+    return false;
+  }
+  len = sizeof peer;
+  if (::getpeername(sockfd, (sockaddr *)&peer, &len) < 0)
+  {
+    return false;
+  }
+  return local.sin_port == peer.sin_port && local.sin_addr.s_addr == peer.sin_addr.s_addr;
+}
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop),
+      serverAddr_(serverAddr),
+      connect_(false),
+      state_(kDisconnected),
+      retryDelayMs_(kInitRetryDelayMs)
+{
+}
+
+Connector::~Connector()
+{
+  // 调用者需要先stop，并且等loop线程处理完
+  if (channel_)
+  {
+    LOG_ERROR("Connector::dtor [%s] channel still alive \n", serverAddr_.toIpPort().c_str());
+  }
+}
+
+void Connector::start()
+{
+  connect_ = true;
+  loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+  if (connect_)
+  {
+    connect();
+  }
+}
+
+void Connector::stop()
+{
+  connect_ = false;
+  loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+  loop_->cancel(retryTimer_);
+  if (state_ == kConnecting)
+  {
+    setState(kDisconnected);
+    int sockfd = removeAndResetChannel();
+    ::close(sockfd);
+  }
+}
+
+void Connector::restart()
+{
+  setState(kDisconnected);
+  retryDelayMs_ = kInitRetryDelayMs;
+  connect_ = true;
+  startInLoop();
+}
+
+void Connector::connect()
+{
+  int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (sockfd < 0)
+  {
+    LOG_FATAL("%s:%s:%d connect socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+  }
+  int ret = ::connect(sockfd, (sockaddr *)serverAddr_.getSockAddr(), sizeof(sockaddr_in));
+  int savedErrno = (ret == 0) ? 0 : errno;
+  switch (savedErrno)
+  {
+  case 0:
+  case EINPROGRESS:
+  case EINTR:
+  case EISCONN:
+    connecting(sockfd);
+    break;
+
+  // 临时性的错误，稍后重试
+  case EAGAIN:
+  case EADDRINUSE:
+  case EADDRNOTAVAIL:
+  case ECONNREFUSED:
+  case ENETUNREACH:
+    retry(sockfd);
+    break;
+
+  default:
+    LOG_ERROR("Connector::connect [%s] error %d \n", serverAddr_.toIpPort().c_str(), savedErrno);
+    ::close(sockfd);
+    setState(kDisconnected);
+    if (connect_ && connectFailedCallback_)
+    {
+      connectFailedCallback_(savedErrno);
+    }
+    break;
+  }
+}
+
+void Connector::connecting(int sockfd)
+{
+  setState(kConnecting);
+  channel_.reset(new Channel(loop_, sockfd));
+  channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+  channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+  // 可写表示connect有了结果，成功或者失败
+  channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+  channel_->disableAll();
+  channel_->remove();
+  int sockfd = channel_->fd();
+  // 现在还在Channel::handleEvent里，不能直接释放channel
+  loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+  return sockfd;
+}
+
+void Connector::resetChannel()
+{
+  channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+  if (state_ != kConnecting)
+  {
+    return;
+  }
+  int sockfd = removeAndResetChannel();
+  int err = getSocketError(sockfd);
+  if (err)
+  {
+    LOG_INFO("Connector::handleWrite [%s] SO_ERROR = %d \n", serverAddr_.toIpPort().c_str(), err);
+    retry(sockfd);
+  }
+  else if (isSelfConnect(sockfd))
+  {
+    LOG_INFO("Connector::handleWrite [%s] self connect \n", serverAddr_.toIpPort().c_str());
+    retry(sockfd);
+  }
+  else
+  {
+    setState(kConnected);
+    if (connect_ && newConnectionCallback_)
+    {
+      newConnectionCallback_(sockfd);
+    }
+    else
+    {
+      ::close(sockfd);
+    }
+  }
+}
+
+void Connector::handleError()
+{
+  if (state_ == kConnecting)
+  {
+    int sockfd = removeAndResetChannel();
+    LOG_INFO("Connector::handleError [%s] SO_ERROR = %d \n", serverAddr_.toIpPort().c_str(), getSocketError(sockfd));
+    retry(sockfd);
+  }
+}
+
+void Connector::retry(int sockfd)
+{
+  ::close(sockfd);
+  setState(kDisconnected);
+  if (connect_)
+  {
+    LOG_INFO("Connector::retry [%s] in %d ms \n", serverAddr_.toIpPort().c_str(), retryDelayMs_);
+    // 定时器持有weak_ptr，Connector先释放时不再重试
+    std::weak_ptr<Connector> weak(shared_from_this());
+    retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0, [weak]()
+                                  {
+      std::shared_ptr<Connector> connector = weak.lock();
+      if (connector)
+      {
+        connector->startInLoop();
+      } });
+    retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
+  }
+}
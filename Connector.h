@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+class Channel;
+class EventLoop;
+
+// 非阻塞connect，失败后按指数退避重试
+// 连接建立之后把sockfd交给newConnectionCallback，之后就不再管这个fd
+// 遇到不会重试的错误(比如EACCES、EAFNOSUPPORT)时停止，并回调connectFailedCallback
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+  using NewConnectionCallback = std::function<void(int sockfd)>;
+  // 参数是connect的errno
+  using ConnectFailedCallback = std::function<void(int err)>;
+
+  Connector(EventLoop *loop, const InetAddress &serverAddr);
+  ~Connector();
+
+  void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+  void setConnectFailedCallback(const ConnectFailedCallback &cb) { connectFailedCallback_ = cb; }
+
+  const InetAddress &serverAddress() const { return serverAddr_; }
+
+  // 任意线程调用
+  void start();
+  // 连接断开后重新连接，重置退避时间，只能在loop线程调用
+  void restart();
+  // 任意线程调用，停止正在进行的connect和重试
+  void stop();
+
+private:
+  enum States
+  {
+    kDisconnected,
+    kConnecting,
+    kConnected
+  };
+  static const int kMaxRetryDelayMs = 30 * 1000;
+  static const int kInitRetryDelayMs = 500;
+
+  void setState(States s) { state_ = s; }
+  void startInLoop();
+  void stopInLoop();
+  void connect();
+  void connecting(int sockfd);
+  void handleWrite();
+  void handleError();
+  void retry(int sockfd);
+  int removeAndResetChannel();
+  void resetChannel();
+
+  EventLoop *loop_;
+  InetAddress serverAddr_;
+  bool connect_;
+  States state_;
+  std::unique_ptr<Channel> channel_;
+  NewConnectionCallback newConnectionCallback_;
+  ConnectFailedCallback connectFailedCallback_;
+  int retryDelayMs_;
+  TimerId retryTimer_;
+};
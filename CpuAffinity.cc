@@ -0,0 +1,124 @@
+#include "CpuAffinity.h"
+#include "Logger.h"
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+std::vector<int> CpuAffinity::availableCpus()
+{
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof set, &set) == 0)
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (CPU_ISSET(cpu, &set))
+      {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+bool CpuAffinity::bindCurrentThread(int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int err = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+  if (err != 0)
+  {
+    LOG_ERROR("bind thread to cpu %d fail, errno: %d \n", cpu, err);
+    return false;
+  }
+  // 进程可能被numactl设成了交错分配，这里改回本地节点；失败不影响绑核
+  if (::syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) < 0)
+  {
+    LOG_DEBUG("set_mempolicy(MPOL_LOCAL) fail, errno: %d \n", errno);
+  }
+  return true;
+}
+
+int CpuAffinity::numaNode(int cpu)
+{
+  char path[64];
+  snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d", cpu);
+  DIR *dir = ::opendir(path);
+  if (dir == nullptr)
+  {
+    return 0;
+  }
+  int node = 0;
+  while (struct dirent *entry = ::readdir(dir))
+  {
+    // 目录下有一个指向所在节点的node<N>链接
+    if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+    {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  ::closedir(dir);
+  return node;
+}
+
+int CpuAffinity::bindNicIrqs(const std::string &ifname, const std::vector<int> &cpus)
+{
+  if (cpus.empty())
+  {
+    return 0;
+  }
+  FILE *fp = ::fopen("/proc/interrupts", "r");
+  if (fp == nullptr)
+  {
+    return 0;
+  }
+  // 中断名字在行尾，比如"eth0-TxRx-3"、"virtio0-input.0"，按出现顺序就是队列顺序
+  std::vector<int> irqs;
+  char line[4096];
+  while (::fgets(line, sizeof line, fp))
+  {
+    int irq;
+    if (sscanf(line, " %d:", &irq) == 1 && strstr(line, ifname.c_str()) != nullptr)
+    {
+      irqs.push_back(irq);
+    }
+  }
+  ::fclose(fp);
+
+  int count = 0;
+  for (size_t i = 0; i < irqs.size(); ++i)
+  {
+    char path[64];
+    snprintf(path, sizeof path, "/proc/irq/%d/smp_affinity_list", irqs[i]);
+    FILE *out = ::fopen(path, "w");
+    if (out == nullptr)
+    {
+      LOG_ERROR("open %s fail, errno: %d \n", path, errno);
+      continue;
+    }
+    int cpu = cpus[i % cpus.size()];
+    bool ok = fprintf(out, "%d\n", cpu) > 0;
+    // 写入错误在fclose刷新时才报告
+    ok = ::fclose(out) == 0 && ok;
+    if (ok)
+    {
+      ++count;
+    }
+    else
+    {
+      LOG_ERROR("set irq %d affinity to cpu %d fail \n", irqs[i], cpu);
+    }
+  }
+  return count;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// 线程绑核、NUMA节点和网卡中断亲和性的辅助函数，只支持Linux
+namespace CpuAffinity
+{
+  // 当前进程允许运行的CPU编号(sched_getaffinity)，按从小到大排列
+  std::vector<int> availableCpus();
+
+  // 把调用线程绑定到cpu上，并把线程的内存策略设为本地节点(MPOL_LOCAL)，
+  // 之后这个线程第一次写到的内存都从cpu所在的NUMA节点分配
+  bool bindCurrentThread(int cpu);
+
+  // cpu所在的NUMA节点，没有NUMA信息时返回0
+  int numaNode(int cpu);
+
+  // 把网卡ifname的各个收发队列中断(/proc/interrupts里名字含ifname的行)
+  // 依次绑到cpus上，第i个中断绑到cpus[i % cpus.size()]，需要root权限
+  // 返回成功设置的中断个数
+  int bindNicIrqs(const std::string &ifname, const std::vector<int> &cpus);
+}
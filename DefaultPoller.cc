@@ -1,14 +1,28 @@
 #include "Poller.h"
+#include "EpollPoller.h"
+#include "IoUringPoller.h"
+#include "PollPoller.h"
+#include "Logger.h"
 #include <stdlib.h>
 
 Poller *Poller::newDefaultPoller(EventLoop *loop)
 {
   if (::getenv("MUDUO_USE_POLL"))
   {
-    return nullptr; // 生成一个PollPoller对象
+    return new PollPoller(loop); // 生成一个PollPoller对象
+  }
+  else if (::getenv("MUDUO_USE_IO_URING"))
+  {
+    if (IoUringPoller::supported())
+    {
+      return new IoUringPoller(loop);
+    }
+    // 内核太老或者被seccomp禁用时退回epoll
+    LOG_INFO("io_uring is not supported, fall back to epoll");
+    return new EpollPoller(loop);
   }
   else
   {
-    return nullptr; // 生成一个EPollPoller对象
+    return new EpollPoller(loop); // 生成一个EPollPoller对象
   }
 }
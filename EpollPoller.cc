@@ -1,5 +1,6 @@
 #include <errno.h>
 #include <unistd.h>
+#include <algorithm>
 #include <strings.h>
 
 #include "EpollPoller.h"
@@ -26,17 +27,20 @@ EpollPoller::~EpollPoller()
 
 Timestamp EpollPoller::poll(int timeoutMs, ChannelList *activateChannels)
 {
-  LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
+  LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, numChannels_);
 
+  flushUpdates();
+  ++pollCalls_;
   int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
   int saveErrno = errno;
   Timestamp now(Timestamp::now());
 
   if (numEvents > 0)
   {
-    LOG_INFO("%d events happened \n", numEvents);
+    LOG_STREAM(DEBUG) << numEvents << " events happened";
     fillActiveChannels(numEvents, activateChannels);
     // 如果事件数目等于events_的大小，说明events_数组已经满了，需要扩容
+    if (numEvents == static_cast<int>(events_.size()))
     {
       events_.resize(events_.size() * 2);
     }
@@ -61,45 +65,102 @@ Timestamp EpollPoller::poll(int timeoutMs, ChannelList *activateChannels)
 void EpollPoller::updateChannel(Channel *channel)
 {
   const int index = channel->index();
-  LOG_INFO("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
+  const int fd = channel->fd();
+  LOG_STREAM(DEBUG) << "updateChannel fd=" << fd << " events=" << channel->events() << " index=" << index;
 
   if (index == kNew || index == kDeleted)
   {
     if (index == kNew)
     {
-      int fd = channel->fd();
-      channels_[fd] = channel;
+      setChannel(fd, channel);
     }
     channel->set_index(kAdded);
-    update(EPOLL_CTL_ADD, channel);
   }
-  else
+  else if (channel->isNoneEvent())
   {
-    if (channel->isNoneEvent())
-    {
-      update(EPOLL_CTL_DEL, channel);
-      channel->set_index(kDeleted);
-    }
-    else
-    {
-      update(EPOLL_CTL_MOD, channel);
-    }
+    channel->set_index(kDeleted);
+  }
+
+  // 只记下来，poll之前再统一调用epoll_ctl
+  FdState *state = fdState(fd);
+  ++state->pendingUpdates;
+  if (!state->dirty)
+  {
+    state->dirty = true;
+    dirtyFds_.push_back(fd);
   }
 }
 
 void EpollPoller::removeChannel(Channel *channel)
 {
   int fd = channel->fd();
-  channels_.erase(fd);
-  LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
-  int index = channel->index();
-  if (index == kAdded)
+  clearChannel(fd);
+  LOG_STREAM(DEBUG) << "removeChannel fd=" << fd;
+  // 调用者接下来通常会close这个fd，所以DEL不能推迟
+  FdState *state = fdState(fd);
+  if (state->registered)
   {
     update(EPOLL_CTL_DEL, channel);
+    state->registered = false;
+    // 这次DEL顶替了一次还没同步的修改
+    if (state->pendingUpdates > 0)
+    {
+      --state->pendingUpdates;
+    }
   }
+  ctlSaved_ += state->pendingUpdates;
+  state->pendingUpdates = 0;
   channel->set_index(kNew);
 }
 
+EpollPoller::FdState *EpollPoller::fdState(int fd)
+{
+  if (static_cast<size_t>(fd) >= fdStates_.size())
+  {
+    fdStates_.resize(std::max(static_cast<size_t>(fd) + 1, fdStates_.size() * 2));
+  }
+  return &fdStates_[fd];
+}
+
+void EpollPoller::flushUpdates()
+{
+  for (int fd : dirtyFds_)
+  {
+    FdState *state = &fdStates_[fd];
+    state->dirty = false;
+    Channel *channel = findChannel(fd);
+    if (channel == nullptr)
+    {
+      // 已经removeChannel了
+      continue;
+    }
+    int events = channel->isNoneEvent() ? 0 : channel->events();
+    int issued = 1;
+    if (state->registered && events == 0)
+    {
+      update(EPOLL_CTL_DEL, channel);
+      state->registered = false;
+    }
+    else if (!state->registered && events != 0)
+    {
+      update(EPOLL_CTL_ADD, channel);
+      state->registered = true;
+    }
+    else if (state->registered && events != state->kernelEvents)
+    {
+      update(EPOLL_CTL_MOD, channel);
+    }
+    else
+    {
+      issued = 0; // 改了又改回来，内核里的状态本来就是对的
+    }
+    state->kernelEvents = events;
+    ctlSaved_ += state->pendingUpdates - issued;
+    state->pendingUpdates = 0;
+  }
+  dirtyFds_.clear();
+}
+
 void EpollPoller::fillActiveChannels(int numEvents, ChannelList *activateChannels) const
 {
   // 遍历所有发生的事件
@@ -120,7 +181,7 @@ void EpollPoller::update(int operation, Channel *channel)
   event.events = channel->events();
   event.data.fd = fd;
   event.data.ptr = channel;
-  // 
+  ++ctlCalls_;
   if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
   {
     if (operation == EPOLL_CTL_DEL)
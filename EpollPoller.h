@@ -19,6 +19,20 @@ public:
 private:
   static const int kInitEventListSize = 16;
 
+  // 每个fd在内核里的注册状态，和基类的channels_一样按fd下标
+  // 关注事件的修改先记在这里，到下一次epoll_wait之前统一同步，
+  // 一轮里反复开关EPOLLOUT只会变成一次epoll_ctl，甚至一次都不需要
+  struct FdState
+  {
+    int kernelEvents;   // 内核里当前注册的事件
+    int pendingUpdates; // 上次同步以来updateChannel被调用的次数
+    bool registered;    // 是否已经EPOLL_CTL_ADD
+    bool dirty;         // 是否在dirtyFds_里
+  };
+
+  FdState *fdState(int fd);
+  // 把dirtyFds_里的修改同步到内核
+  void flushUpdates();
   // 填写活跃的连接
   void fillActiveChannels(int numEvents, ChannelList *activateChannels) const;
   // 更新channel通道
@@ -29,4 +43,6 @@ private:
   int epollfd_;
 
   EventList events_;
+  std::vector<FdState> fdStates_;
+  std::vector<int> dirtyFds_;
 };
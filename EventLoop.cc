@@ -2,18 +2,54 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <memory>
 
 #include "EventLoop.h"
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "TimingWheel.h"
+#include "BufferPool.h"
+#include "Tracer.h"
 // 防止一个线程创建多个eventloop
 __thread EventLoop *t_loopInThisThread = nullptr;
 
 // 定义默认的IO复用接口的超时时间
 const int kPollTimeMs = 10000;
 
+// 统计忙碌占比的窗口长度
+const int64_t kBusyWindowMicroSeconds = 100 * 1000;
+
+// 两个时间点之间的微秒数，系统时间被往回调时记为0
+static uint64_t elapsedMicroSeconds(Timestamp from, Timestamp to)
+{
+  int64_t diff = to.microSecondsSinceEpoch() - from.microSecondsSinceEpoch();
+  return diff > 0 ? static_cast<uint64_t>(diff) : 0;
+}
+
+// 每个loop最多缓存这么多空闲任务节点，突发流量过后多出来的直接释放
+const size_t kMaxFreeFunctors = 4096;
+
+// 线程局部的空闲任务节点，从某个loop的freeFunctors_整串取来，供本线程投递任务用
+struct PendingFunctorCache
+{
+  EventLoop::PendingFunctor *head = nullptr;
+
+  ~PendingFunctorCache()
+  {
+    while (head)
+    {
+      EventLoop::PendingFunctor *next = static_cast<EventLoop::PendingFunctor *>(head->next_.load(std::memory_order_relaxed));
+      delete head;
+      head = next;
+    }
+  }
+};
+
+thread_local PendingFunctorCache t_pendingFunctorCache;
+
 // 创建wakeupfd，用来通知处理新来的channel
 int createEventfd()
 {
@@ -28,11 +64,27 @@ int createEventfd()
 EventLoop::EventLoop()
     : looping_(false),
       quit_(false),
-      callingPendingFunctors_(false),
       threadId_(CurrentThread::tid()),
+      bufferPool_(new BufferPool(::getenv("MUDUO_BUFFER_HUGEPAGES") != nullptr)),
       poller_(Poller::newDefaultPoller(this)),
+      timerQueue_(new TimerQueue(this)),
       wakeupFd_(createEventfd()),
-      wakeupChannel_(new Channel(this, wakeupFd_))
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      callingPendingFunctors_(false),
+      wakeupPending_(false),
+      wakeupCount_(0),
+      freeFunctors_(nullptr),
+      numFreeFunctors_(0),
+      numConnections_(0),
+      queuedBytes_(0),
+      busyPermille_(0),
+      spinPermille_(0),
+      busyWindowStart_(Timestamp::now()),
+      lastIterationEnd_(busyWindowStart_),
+      busyMicroSeconds_(0),
+      spinMicroSeconds_(0),
+      busyPollMicroSeconds_(0),
+      metricsEnabled_(true)
 {
   LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
   // 在构造的时候发现如果已经有了，则报错
@@ -56,6 +108,17 @@ EventLoop::~EventLoop()
   wakeupChannel_->remove();
   // 关闭文件描述符
   ::close(wakeupFd_);
+  while (MpscNode *node = pendingFunctors_.pop())
+  {
+    delete static_cast<PendingFunctor *>(node);
+  }
+  PendingFunctor *node = freeFunctors_.exchange(nullptr, std::memory_order_acquire);
+  while (node)
+  {
+    PendingFunctor *next = static_cast<PendingFunctor *>(node->next_.load(std::memory_order_relaxed));
+    delete node;
+    node = next;
+  }
   t_loopInThisThread = nullptr;
 }
 
@@ -66,24 +129,78 @@ void EventLoop::loop()
   quit_ = false;
 
   LOG_INFO("EventLoop %p start looping", this);
+  // 从构造到开始loop的时间不算在第一次poll里
+  lastIterationEnd_ = Timestamp::now();
   while (!quit_)
   {
     activeChannels_.clear();
+    // 忙轮询期间不阻塞，用上一轮结束的时间判断是否还在预算内，不额外取时间
+    bool spinning = busyPollMicroSeconds_ > 0 &&
+                    lastIterationEnd_.microSecondsSinceEpoch() - lastActiveTime_.microSecondsSinceEpoch() < busyPollMicroSeconds_;
     // 监听有哪些activate channels,写入activateChannels_
-    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+    {
+      TraceSpan span("poll", -1);
+      pollReturnTime_ = poller_->poll(spinning ? 0 : kPollTimeMs, &activeChannels_);
+    }
+    if (!activeChannels_.empty())
+    {
+      lastActiveTime_ = pollReturnTime_;
+    }
+    if (metricsEnabled_)
+    {
+      metrics_.iterations.add(1);
+      metrics_.events.add(activeChannels_.size());
+      metrics_.eventsPerPoll.record(activeChannels_.size());
+      metrics_.pollTime.record(elapsedMicroSeconds(lastIterationEnd_, pollReturnTime_));
+    }
     for (Channel *channel : activeChannels_)
     {
       // 检查有哪些activechannels_,处理对应的事件
       // ? 这为什么要传入这个参数(ans: 作为一个时间戳)
       channel->handleEvent(pollReturnTime_);
     }
+    Timestamp handlersEnd;
+    if (metricsEnabled_)
+    {
+      handlersEnd = Timestamp::now();
+      metrics_.handlerTime.record(elapsedMicroSeconds(pollReturnTime_, handlersEnd));
+    }
     // 执行待处理的回调操作
     doPendingFunctors();
+    Timestamp now(Timestamp::now());
+    if (metricsEnabled_)
+    {
+      metrics_.functorTime.record(elapsedMicroSeconds(handlersEnd, now));
+    }
+    updateBusyRatio(now, spinning && activeChannels_.empty());
   }
   LOG_INFO("Eventloop %p stop looping. \n", this);
   looping_ = false;
 }
 
+void EventLoop::updateBusyRatio(Timestamp now, bool spun)
+{
+  if (spun)
+  {
+    // 空转的一轮从上一轮结束算起，整轮都是空转
+    spinMicroSeconds_ += now.microSecondsSinceEpoch() - lastIterationEnd_.microSecondsSinceEpoch();
+  }
+  else
+  {
+    busyMicroSeconds_ += now.microSecondsSinceEpoch() - pollReturnTime_.microSecondsSinceEpoch();
+  }
+  lastIterationEnd_ = now;
+  int64_t window = now.microSecondsSinceEpoch() - busyWindowStart_.microSecondsSinceEpoch();
+  if (window >= kBusyWindowMicroSeconds)
+  {
+    busyPermille_.store(static_cast<int>(busyMicroSeconds_ * 1000 / window), std::memory_order_relaxed);
+    spinPermille_.store(static_cast<int>(spinMicroSeconds_ * 1000 / window), std::memory_order_relaxed);
+    busyWindowStart_ = now;
+    busyMicroSeconds_ = 0;
+    spinMicroSeconds_ = 0;
+  }
+}
+
 void EventLoop::quit()
 {
   // 这里有一个误区，不是说其他线程执行这个函数，而是从其他线程中调用这个函数
@@ -104,22 +221,24 @@ void EventLoop::runInLoop(Functor cb)
   else
   {
     // 如果不是在当前的loop线程中执行，则需要先唤醒
-    queueInLoop(cb);
+    queueInLoop(std::move(cb));
   }
 }
 
 void EventLoop::queueInLoop(Functor cb)
 {
-  // 通过代码块包括，控制锁的生命周期
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    pendingFunctors_.emplace_back(cb);
-  } // 这里锁会在代码块结束时自动释放
+  PendingFunctor *pending = newPendingFunctor();
+  pending->functor = std::move(cb);
+  pendingFunctors_.push(pending);
 
-  // 唤醒对应的
+  // 必须在入队完成之后检查标志：loop在取队列之前清掉标志，
+  // 所以要么loop这一轮能看到这个节点，要么这里看到false并负责唤醒
   if (!isInLoopThread() || callingPendingFunctors_)
   {
-    wakeup();
+    if (!wakeupPending_.exchange(true, std::memory_order_acq_rel))
+    {
+      wakeup();
+    }
   }
 }
 
@@ -133,17 +252,67 @@ void EventLoop::handleRead()
     LOG_ERROR("Eventloop::handleRead() reads %lu bytes instead of 8", n);
   }
 }
-// 唤醒loop所在的线程
+// 唤醒loop所在的线程，向wakeupFd_写数据，使其可读
 void EventLoop::wakeup()
 {
   uint64_t one = 1;
-  ssize_t n = read(wakeupFd_, &one, sizeof one);
+  wakeupCount_.fetch_add(1, std::memory_order_relaxed);
+  ssize_t n = write(wakeupFd_, &one, sizeof one);
   if (n != sizeof one)
   {
-    LOG_ERROR("Eventloop::wakeup() reads %lu bytes instead of 8", n);
+    LOG_ERROR("Eventloop::wakeup() writes %lu bytes instead of 8", n);
   }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+  return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+  Timestamp time(addTime(Timestamp::now(), delay));
+  return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+  Timestamp time(addTime(Timestamp::now(), interval));
+  return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+  timerQueue_->cancel(timerId);
+}
+
+TimingWheel *EventLoop::timingWheel()
+{
+  if (!timingWheel_)
+  {
+    timingWheel_.reset(new TimingWheel);
+    TimingWheel *wheel = timingWheel_.get();
+    runEvery(1.0, [wheel]()
+             { wheel->tick(); });
+  }
+  return timingWheel_.get();
+}
+
+uint64_t EventLoop::pollCalls() const
+{
+  return poller_->pollCalls();
+}
+
+uint64_t EventLoop::pollerCtlCalls() const
+{
+  return poller_->ctlCalls();
+}
+
+uint64_t EventLoop::pollerCtlCallsSaved() const
+{
+  return poller_->ctlCallsSaved();
+}
+
 void EventLoop::updateChannel(Channel *channel)
 {
   poller_->updateChannel(channel);
@@ -159,16 +328,79 @@ bool EventLoop::hasChannel(Channel *channel)
 
 void EventLoop::doPendingFunctors()
 {
-  std::vector<Functor> functors;
   callingPendingFunctors_ = true;
+  wakeupPending_.exchange(false, std::memory_order_acq_rel);
+
+  // 先取出当前所有的回调再执行，回调里再queueInLoop的留到下一轮，
+  // 和原来swap出一个vector的语义相同，不会被自我续命的回调饿死
+  while (MpscNode *node = pendingFunctors_.pop())
   {
-    std::unique_lock<std::mutex> lock(mutex_);
-    functors.swap(pendingFunctors_);
+    runningFunctors_.push_back(static_cast<PendingFunctor *>(node));
   }
-
-  for (const Functor &functor : functors)
+  if (metricsEnabled_)
   {
-    functor();
+    metrics_.functorsPerRun.record(runningFunctors_.size());
+    metrics_.functors.add(runningFunctors_.size());
   }
+  PendingFunctor *first = nullptr;
+  PendingFunctor *last = nullptr;
+  for (PendingFunctor *pending : runningFunctors_)
+  {
+    {
+      TraceSpan span("functor", -1);
+      pending->functor();
+    }
+    // 立刻析构，捕获的shared_ptr等不能跟着节点留在缓存里
+    pending->functor.reset();
+    pending->next_.store(first, std::memory_order_relaxed);
+    first = pending;
+    if (last == nullptr)
+    {
+      last = pending;
+    }
+  }
+  if (first)
+  {
+    recyclePendingFunctors(first, last, runningFunctors_.size());
+  }
+  runningFunctors_.clear();
   callingPendingFunctors_ = false;
+}
+
+EventLoop::PendingFunctor *EventLoop::newPendingFunctor()
+{
+  PendingFunctorCache &cache = t_pendingFunctorCache;
+  if (cache.head == nullptr)
+  {
+    cache.head = freeFunctors_.exchange(nullptr, std::memory_order_acquire);
+    if (cache.head == nullptr)
+    {
+      return new PendingFunctor;
+    }
+    numFreeFunctors_.store(0, std::memory_order_relaxed);
+  }
+  PendingFunctor *pending = cache.head;
+  cache.head = static_cast<PendingFunctor *>(pending->next_.load(std::memory_order_relaxed));
+  return pending;
+}
+
+void EventLoop::recyclePendingFunctors(PendingFunctor *first, PendingFunctor *last, size_t count)
+{
+  // 计数只是个近似值，用来限制缓存上限，不影响正确性
+  if (numFreeFunctors_.load(std::memory_order_relaxed) + count > kMaxFreeFunctors)
+  {
+    while (first)
+    {
+      PendingFunctor *next = static_cast<PendingFunctor *>(first->next_.load(std::memory_order_relaxed));
+      delete first;
+      first = next;
+    }
+    return;
+  }
+  numFreeFunctors_.fetch_add(count, std::memory_order_relaxed);
+  PendingFunctor *head = freeFunctors_.load(std::memory_order_relaxed);
+  do
+  {
+    last->next_.store(head, std::memory_order_relaxed);
+  } while (!freeFunctors_.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
 }
\ No newline at end of file
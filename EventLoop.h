@@ -3,21 +3,29 @@
 #include <functional>
 #include <memory>
 #include <vector>
-#include <mutex>
 #include <atomic>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
+#include "Task.h"
+#include "LoopMetrics.h"
 class Channel;
 class Poller;
+class TimerQueue;
+class TimingWheel;
+class BufferPool;
 
 // 事件循环类
 // 主要包含了两个模块 channel poller
 class EventLoop : noncopyable
 {
 public:
-  using Functor = std::function<void()>;
+  // 只能移动，内联64字节，常见的跨线程任务不分配内存
+  using Functor = Task;
 
   EventLoop();
   ~EventLoop();
@@ -32,10 +40,68 @@ public:
   // 在当前loop中执行cb
   void runInLoop(Functor cb);
   // 把cb放入队列中，唤醒loop所在的线程，执行cb
+  // 无锁入队，一批连续的跨线程调用只写一次eventfd
   void queueInLoop(Functor cb);
 
+  // 定时器接口，线程安全
+  // 在time时刻执行cb
+  TimerId runAt(Timestamp time, TimerCallback cb);
+  // 在delay秒之后执行cb
+  TimerId runAfter(double delay, TimerCallback cb);
+  // 每隔interval秒执行一次cb
+  TimerId runEvery(double interval, TimerCallback cb);
+  // 取消定时器
+  void cancel(TimerId timerId);
+
+  // 每个loop一个分层时间轮，精度1秒，用于海量连接的空闲超时
+  // 第一次调用时创建，只能在loop线程中使用
+  TimingWheel *timingWheel();
+
+  // 本loop上所有连接共用的缓冲区内存池，只能在loop线程中使用
+  // 设置环境变量MUDUO_BUFFER_HUGEPAGES时使用大页arena
+  BufferPool *bufferPool() { return bufferPool_.get(); }
+
   // 用来唤醒loop所在的线程的
   void wakeup();
+  // 累计写eventfd的次数，用来观察唤醒合并的效果
+  uint64_t wakeupCount() const { return wakeupCount_.load(std::memory_order_relaxed); }
+
+  // poller的系统调用计数，只能在loop线程中读取
+  uint64_t pollCalls() const;
+  uint64_t pollerCtlCalls() const;
+  uint64_t pollerCtlCallsSaved() const;
+
+  // 负载信息，供EventLoopThreadPool分配连接时无锁读取，任意线程可读
+  // 本loop上的连接数，TcpConnection构造时加一、connectDestroyed时减一
+  int numConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+  // 本loop上所有连接输出队列里还没发出去的字节数
+  int64_t queuedBytes() const { return queuedBytes_.load(std::memory_order_relaxed); }
+  // 最近一个统计窗口里处理事件(不阻塞在poll里)的时间占比，千分之一为单位
+  // 只在poll返回时更新，loop长时间阻塞时保持上一个窗口的值
+  int busyPermille() const { return busyPermille_.load(std::memory_order_relaxed); }
+  // 同一个窗口里忙轮询(超时为0的poll没有拿到事件)花掉的时间占比，千分之一为单位
+  int spinPermille() const { return spinPermille_.load(std::memory_order_relaxed); }
+
+  // 忙轮询：有事件之后的microSeconds微秒内用超时为0的poll空转等待下一个事件，
+  // 省掉睡眠和唤醒的延迟，超过这个时间没有事件再回到阻塞的poll，0表示关闭(默认)
+  // 空转会占满一个核，只适合绑核且对延迟敏感的loop，需要在loop线程中或loop开始之前调用
+  void setBusyPoll(int microSeconds) { busyPollMicroSeconds_ = microSeconds; }
+
+  // 运行指标，任意线程可读，不会阻塞loop，见LoopMetrics
+  const LoopMetrics &metrics() const { return metrics_; }
+  // 连接统计收发字节用，只能在loop线程中调用
+  LoopMetrics &metrics() { return metrics_; }
+  // 关闭后loop每轮少取一次时间，只保留收发字节数，默认打开
+  // 需要在loop线程中或loop开始之前调用
+  void setMetricsEnabled(bool on) { metricsEnabled_ = on; }
+
+  void connectionAdded() { numConnections_.fetch_add(1, std::memory_order_relaxed); }
+  void connectionRemoved() { numConnections_.fetch_sub(1, std::memory_order_relaxed); }
+  // 只能在loop线程中调用
+  void addQueuedBytes(int64_t delta)
+  {
+    queuedBytes_.store(queuedBytes_.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  }
 
   // 调用channel里面的方法
   void updateChannel(Channel *channel);
@@ -49,8 +115,21 @@ public:
   }
 
 private:
+  friend struct PendingFunctorCache;
+
+  // 侵入式队列的节点，执行完不释放而是放回freeFunctors_，
+  // 生产者线程整串取走缓存在线程局部，稳态下投递任务不分配内存
+  struct PendingFunctor : MpscNode
+  {
+    Functor functor;
+  };
+
   void handleRead();
   void doPendingFunctors();
+  // 一轮处理结束，累计忙碌或空转的时间，窗口结束时发布busyPermille_和spinPermille_
+  void updateBusyRatio(Timestamp now, bool spun);
+  PendingFunctor *newPendingFunctor();
+  void recyclePendingFunctors(PendingFunctor *first, PendingFunctor *last, size_t count);
 
   using ChannelList = std::vector<Channel *>;
 
@@ -60,7 +139,10 @@ private:
   const pid_t threadId_; // 记录当前loop所在线程的id
 
   Timestamp pollReturnTime_; // poller返回发生事件的channels的时间点
+  std::unique_ptr<BufferPool> bufferPool_;
   std::unique_ptr<Poller> poller_;
+  std::unique_ptr<TimerQueue> timerQueue_;
+  std::unique_ptr<TimingWheel> timingWheel_;
 
   int wakeupFd_;
   std::unique_ptr<Channel> wakeupChannel_;
@@ -68,6 +150,27 @@ private:
   ChannelList activeChannels_;
 
   std::atomic_bool callingPendingFunctors_;
-  std::vector<Functor> pendingFunctors_;
-  std::mutex mutex_;
+  MpscQueue pendingFunctors_;
+  std::vector<PendingFunctor *> runningFunctors_; // doPendingFunctors复用，避免每轮分配
+  // 已经写过eventfd、loop还没来得及处理，此时其他生产者不必再写
+  std::atomic_bool wakeupPending_;
+  std::atomic<uint64_t> wakeupCount_;
+  // 空闲节点栈，只有loop线程压入，生产者用exchange整串取走，没有ABA问题
+  std::atomic<PendingFunctor *> freeFunctors_;
+  std::atomic<size_t> numFreeFunctors_;
+
+  std::atomic<int> numConnections_;
+  std::atomic<int64_t> queuedBytes_;
+  std::atomic<int> busyPermille_;
+  std::atomic<int> spinPermille_;
+  Timestamp busyWindowStart_;
+  Timestamp lastIterationEnd_;
+  int64_t busyMicroSeconds_;
+  int64_t spinMicroSeconds_;
+
+  int busyPollMicroSeconds_;
+  Timestamp lastActiveTime_; // 最近一次poll拿到事件的时间
+
+  LoopMetrics metrics_;
+  bool metricsEnabled_;
 };
\ No newline at end of file
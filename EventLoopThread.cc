@@ -1,6 +1,7 @@
 
 #include "EventLoopThread.h"
 #include "EventLoop.h"
+#include "CpuAffinity.h"
 
 EventLoopThread::EventLoopThread(
     const ThreadInitCallback &cb,
@@ -10,7 +11,8 @@ EventLoopThread::EventLoopThread(
       thread_(std::bind(&EventLoopThread::threadFunc, this), name),
       mutex_(),
       cond_(),
-      callback_(cb)
+      callback_(cb),
+      cpu_(-1)
 {
 }
 
@@ -43,6 +45,10 @@ EventLoop *EventLoopThread::startLoop()
 
 void EventLoopThread::threadFunc()
 {
+  if (cpu_ >= 0)
+  {
+    CpuAffinity::bindCurrentThread(cpu_);
+  }
   EventLoop loop; // 创建一个独立的eventloop，和上面的线程是一一对应的，one loop per thread
   if (callback_)
   {
@@ -15,9 +15,13 @@ class EventLoopThread : noncopyable
 public:
   using ThreadInitCallback = std::function<void(EventLoop *)>;
 
-  EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), const std::string &name = std::string(0));
+  EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), const std::string &name = std::string());
   ~EventLoopThread();
 
+  // 线程启动后先绑定到cpu上再创建EventLoop，loop的内存从cpu所在的NUMA节点分配
+  // 需要在startLoop之前设置，-1表示不绑核
+  void setCpu(int cpu) { cpu_ = cpu; }
+
   EventLoop *startLoop();
 
 private:
@@ -28,4 +32,5 @@ private:
   std::mutex mutex_;
   std::condition_variable cond_;
   ThreadInitCallback callback_;
+  int cpu_;
 };
\ No newline at end of file
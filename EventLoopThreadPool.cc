@@ -1,14 +1,32 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
 
 #include <memory>
+#include <algorithm>
+
+// murmur3的最后一步，把相邻的整数打散
+static uint32_t mix32(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg)
     : baseLoop_(baseLoop),
       name_(nameArg),
       started_(false),
       numThreads_(0),
-      next_(0)
+      next_(0),
+      placement_(kRoundRobin),
+      loadSignal_(kActiveConnections),
+      randomState_(static_cast<uint64_t>(Timestamp::now().microSecondsSinceEpoch()) | 1)
 {
 }
 
@@ -25,6 +43,10 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     char buf[name_.size() + 32];
     snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
     EventLoopThread *t = new EventLoopThread(cb, buf);
+    if (!cpus_.empty())
+    {
+      t->setCpu(cpus_[i % cpus_.size()]);
+    }
     threads_.push_back(std::unique_ptr<EventLoopThread>(t));
     loops_.push_back(t->startLoop());
   }
@@ -33,6 +55,11 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
   {
     cb(baseLoop_);
   }
+
+  if (placement_ == kConsistentHash)
+  {
+    buildHashRing();
+  }
 }
 
 EventLoop *EventLoopThreadPool::getNextLoop()
@@ -53,6 +80,101 @@ EventLoop *EventLoopThreadPool::getNextLoop()
   return loop;
 }
 
+EventLoop *EventLoopThreadPool::getLoopForConnection(const InetAddress &peerAddr)
+{
+  if (loops_.size() <= 1)
+  {
+    return getNextLoop();
+  }
+  switch (placement_)
+  {
+  case kLeastConnections:
+    return leastLoaded();
+  case kPowerOfTwoChoices:
+    return powerOfTwoChoices();
+  case kConsistentHash:
+    return consistentHash(peerAddr);
+  default:
+    return getNextLoop();
+  }
+}
+
+int64_t EventLoopThreadPool::load(EventLoop *loop) const
+{
+  switch (loadSignal_)
+  {
+  case kQueuedBytes:
+    return loop->queuedBytes();
+  case kBusyRatio:
+    return loop->busyPermille();
+  default:
+    return loop->numConnections();
+  }
+}
+
+EventLoop *EventLoopThreadPool::leastLoaded()
+{
+  // 负载相同时从轮询位置开始选，避免总是落在第一个loop上
+  size_t n = loops_.size();
+  size_t best = next_;
+  int64_t bestLoad = load(loops_[best]);
+  for (size_t i = 1; i < n && bestLoad > 0; ++i)
+  {
+    size_t index = (next_ + i) % n;
+    int64_t l = load(loops_[index]);
+    if (l < bestLoad)
+    {
+      best = index;
+      bestLoad = l;
+    }
+  }
+  next_ = static_cast<int>((next_ + 1) % n);
+  return loops_[best];
+}
+
+EventLoop *EventLoopThreadPool::powerOfTwoChoices()
+{
+  // xorshift64*
+  randomState_ ^= randomState_ >> 12;
+  randomState_ ^= randomState_ << 25;
+  randomState_ ^= randomState_ >> 27;
+  uint64_t r = randomState_ * 2685821657736338717ULL;
+
+  size_t n = loops_.size();
+  size_t a = static_cast<size_t>(r >> 32) % n;
+  size_t b = static_cast<size_t>(r & 0xffffffff) % (n - 1);
+  // 保证两次选的不是同一个loop
+  if (b >= a)
+  {
+    ++b;
+  }
+  return load(loops_[b]) < load(loops_[a]) ? loops_[b] : loops_[a];
+}
+
+EventLoop *EventLoopThreadPool::consistentHash(const InetAddress &peerAddr)
+{
+  uint32_t h = mix32(peerAddr.getSockAddr()->sin_addr.s_addr);
+  auto it = std::lower_bound(hashRing_.begin(), hashRing_.end(), std::make_pair(h, 0));
+  if (it == hashRing_.end())
+  {
+    it = hashRing_.begin();
+  }
+  return loops_[it->second];
+}
+
+void EventLoopThreadPool::buildHashRing()
+{
+  hashRing_.clear();
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    for (int v = 0; v < kVirtualNodes; ++v)
+    {
+      hashRing_.push_back(std::make_pair(mix32(static_cast<uint32_t>(i * kVirtualNodes + v) * 0x9e3779b9u), static_cast<int>(i)));
+    }
+  }
+  std::sort(hashRing_.begin(), hashRing_.end());
+}
+
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
 {
   if (loops_.empty())
@@ -61,6 +183,6 @@ std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
   }
   else
   {
-    loops_;
+    return loops_;
   }
 }
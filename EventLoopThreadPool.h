@@ -3,25 +3,59 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <stdint.h>
 
 #include "noncopyable.h"
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable
 {
 public:
   using ThreadInitCallback = std::function<void(EventLoop *)>;
 
+  // 新连接分配到哪个ioLoop
+  enum Placement
+  {
+    kRoundRobin,
+    // 连接数最少的loop，每次遍历所有loop
+    kLeastConnections,
+    // 随机取两个loop，选负载低的那个
+    kPowerOfTwoChoices,
+    // 按对端IP做一致性哈希，同一个客户端总是落在同一个loop上
+    kConsistentHash,
+  };
+
+  // kLeastConnections和kPowerOfTwoChoices比较的负载，见EventLoop的负载信息
+  enum LoadSignal
+  {
+    kActiveConnections,
+    kQueuedBytes,
+    kBusyRatio,
+  };
+
   EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
   ~EventLoopThreadPool();
 
   void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+  // 第i个ioLoop线程绑定到cpus[i % cpus.size()]，空表示不绑核，需要在start之前设置
+  // 没有ioLoop线程时不会去绑baseLoop所在的线程
+  void setThreadAffinity(const std::vector<int> &cpus) { cpus_ = cpus; }
+  // 需要在start之前设置
+  void setPlacement(Placement placement, LoadSignal signal = kActiveConnections)
+  {
+    placement_ = placement;
+    loadSignal_ = signal;
+  }
 
   void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
   EventLoop *getNextLoop();
+  // 按设置的策略给来自peerAddr的新连接选一个loop，只读各loop的原子计数，不加锁
+  // 和getNextLoop一样只能在baseLoop线程中调用
+  EventLoop *getLoopForConnection(const InetAddress &peerAddr);
 
   std::vector<EventLoop *> getAllLoops();
 
@@ -30,6 +64,15 @@ public:
   const std::string name() { return name_; }
 
 private:
+  // 一致性哈希环上每个loop的虚拟节点数
+  static const int kVirtualNodes = 64;
+
+  int64_t load(EventLoop *loop) const;
+  EventLoop *leastLoaded();
+  EventLoop *powerOfTwoChoices();
+  EventLoop *consistentHash(const InetAddress &peerAddr);
+  void buildHashRing();
+
   EventLoop *baseLoop_;
   std::string name_;
   bool started_;
@@ -37,4 +80,10 @@ private:
   int next_;
   std::vector<std::unique_ptr<EventLoopThread>> threads_;
   std::vector<EventLoop *> loops_;
+  std::vector<int> cpus_;
+  Placement placement_;
+  LoadSignal loadSignal_;
+  uint64_t randomState_;
+  // (哈希值, loop下标)，按哈希值排序
+  std::vector<std::pair<uint32_t, int>> hashRing_;
 };
\ No newline at end of file
@@ -0,0 +1,426 @@
+#include <errno.h>
+#include <algorithm>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include "IoUringPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+namespace
+{
+  const int kNew = -1;
+  const int kAdded = 1;
+  const int kDeleted = 2;
+
+  // POLL_REMOVE请求自己的完成事件不关心
+  const uint64_t kIgnoredUserData = ~0ULL;
+
+  // 需要的特性：NODROP保证完成事件不丢，EXT_ARG支持带超时的等待，
+  // RSRC_TAGS(5.13)之后的内核才有multishot poll
+  const unsigned kRequiredFeatures = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+
+  int ioUringSetup(unsigned entries, io_uring_params *p)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+  }
+
+  int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void *arg, size_t argsz)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argsz));
+  }
+
+  int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+  }
+
+  uint64_t encodeUserData(int fd, uint32_t generation)
+  {
+    return (static_cast<uint64_t>(fd) << 32) | generation;
+  }
+
+  bool probe()
+  {
+    io_uring_params params;
+    memset(&params, 0, sizeof params);
+    int fd = ioUringSetup(4, &params);
+    if (fd < 0)
+    {
+      return false;
+    }
+    bool ok = (params.features & kRequiredFeatures) == kRequiredFeatures;
+    if (ok)
+    {
+      const int kOps = 64;
+      size_t len = sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op);
+      io_uring_probe *p = static_cast<io_uring_probe *>(calloc(1, len));
+      ok = ioUringRegister(fd, IORING_REGISTER_PROBE, p, kOps) == 0 &&
+           p->last_op >= IORING_OP_POLL_REMOVE &&
+           (p->ops[IORING_OP_POLL_ADD].flags & IO_URING_OP_SUPPORTED) &&
+           (p->ops[IORING_OP_POLL_REMOVE].flags & IO_URING_OP_SUPPORTED);
+      free(p);
+    }
+    ::close(fd);
+    return ok;
+  }
+}
+
+bool IoUringPoller::supported()
+{
+  static const bool ok = probe();
+  return ok;
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop),
+      ringFd_(-1),
+      sqEntries_(0),
+      sqRing_(nullptr),
+      sqRingSize_(0),
+      sqes_(nullptr),
+      sqesSize_(0),
+      sqLocalTail_(0),
+      cqRing_(nullptr),
+      cqRingSize_(0)
+{
+  io_uring_params params;
+  memset(&params, 0, sizeof params);
+  // CQ开大一些，一轮里一个channel可能有多个完成事件
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+  params.cq_entries = kRingEntries * 4;
+  ringFd_ = ioUringSetup(kRingEntries, &params);
+  if (ringFd_ < 0 && errno == EINVAL)
+  {
+    // 老内核不认识后两个标志
+    memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kRingEntries * 4;
+    ringFd_ = ioUringSetup(kRingEntries, &params);
+  }
+  if (ringFd_ < 0)
+  {
+    LOG_FATAL("io_uring_setup error:%d \n", errno);
+  }
+  sqEntries_ = params.sq_entries;
+
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+  }
+  sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+  if (sqRing_ == MAP_FAILED)
+  {
+    LOG_FATAL("io_uring mmap sq ring error:%d \n", errno);
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    cqRing_ = sqRing_;
+  }
+  else
+  {
+    cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+    if (cqRing_ == MAP_FAILED)
+    {
+      LOG_FATAL("io_uring mmap cq ring error:%d \n", errno);
+    }
+  }
+  sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe *>(::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED)
+  {
+    LOG_FATAL("io_uring mmap sqes error:%d \n", errno);
+  }
+
+  char *sq = static_cast<char *>(sqRing_);
+  sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  sqLocalTail_ = *sqTail_;
+
+  char *cq = static_cast<char *>(cqRing_);
+  cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+IoUringPoller::~IoUringPoller()
+{
+  // 还没提交的POLL_REMOVE要提交掉，挂着的poll请求会一直持有fd对应的文件，
+  // 比如已经close的监听socket会继续留在SO_REUSEPORT组里
+  unsigned pending = sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+  if (pending > 0)
+  {
+    enter(pending, false, 0);
+  }
+  ::munmap(sqes_, sqesSize_);
+  if (cqRing_ != sqRing_)
+  {
+    ::munmap(cqRing_, cqRingSize_);
+  }
+  ::munmap(sqRing_, sqRingSize_);
+  ::close(ringFd_);
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+  LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, numChannels_);
+
+  // 上一轮触发过的单次poll在事件处理完之后重新挂上，和这一轮的修改一起提交
+  for (int fd : rearmList_)
+  {
+    Slot *s = slot(fd);
+    s->rearm = false;
+    if (findChannel(fd) && s->events != 0 && !s->armed)
+    {
+      arm(fd, s);
+    }
+  }
+  rearmList_.clear();
+
+  ++pollCalls_;
+  // 超时为0(忙轮询)时只提交不等待，省掉内核里设置超时
+  int ret = enter(sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE), timeoutMs != 0, timeoutMs);
+  int saveErrno = errno;
+  Timestamp now(Timestamp::now());
+
+  reapCompletions(activeChannels);
+  if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR && saveErrno != EBUSY)
+  {
+    errno = saveErrno;
+    LOG_ERROR("IoUringPoller::poll() err!");
+  }
+  return now;
+}
+
+void IoUringPoller::updateChannel(Channel *channel)
+{
+  const int index = channel->index();
+  const int fd = channel->fd();
+  LOG_STREAM(DEBUG) << "updateChannel fd=" << fd << " events=" << channel->events() << " index=" << index;
+
+  Slot *s = slot(fd);
+  if (index == kNew || index == kDeleted)
+  {
+    if (index == kNew)
+    {
+      setChannel(fd, channel);
+    }
+    channel->set_index(kAdded);
+    s->events = channel->events();
+    s->multishot = channel->edgeTriggered();
+    if (s->events != 0)
+    {
+      arm(fd, s);
+    }
+  }
+  else if (channel->isNoneEvent())
+  {
+    disarm(fd, s);
+    s->events = 0;
+    channel->set_index(kDeleted);
+  }
+  else if (s->events != static_cast<uint32_t>(channel->events()))
+  {
+    disarm(fd, s);
+    s->events = channel->events();
+    s->multishot = channel->edgeTriggered();
+    arm(fd, s);
+  }
+  else if (!s->armed && !s->rearm)
+  {
+    arm(fd, s);
+  }
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+  int fd = channel->fd();
+  clearChannel(fd);
+  LOG_STREAM(DEBUG) << "removeChannel fd=" << fd;
+  Slot *s = slot(fd);
+  disarm(fd, s);
+  s->events = 0;
+  s->failed = false;
+  channel->set_index(kNew);
+}
+
+IoUringPoller::Slot *IoUringPoller::slot(int fd)
+{
+  if (static_cast<size_t>(fd) >= slots_.size())
+  {
+    slots_.resize(std::max(static_cast<size_t>(fd) + 1, slots_.size() * 2));
+  }
+  return &slots_[fd];
+}
+
+io_uring_sqe *IoUringPoller::getSqe()
+{
+  unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+  if (sqLocalTail_ - head >= sqEntries_)
+  {
+    // SQ满了，先把攒下的提交掉，不等待完成
+    ++ctlCalls_;
+    enter(sqLocalTail_ - head, false, 0);
+    head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqLocalTail_ - head >= sqEntries_)
+    {
+      LOG_FATAL("io_uring sq full, errno:%d \n", errno);
+    }
+  }
+  unsigned idx = sqLocalTail_ & *sqMask_;
+  io_uring_sqe *sqe = &sqes_[idx];
+  memset(sqe, 0, sizeof *sqe);
+  sqArray_[idx] = idx;
+  ++sqLocalTail_;
+  return sqe;
+}
+
+void IoUringPoller::arm(int fd, Slot *s)
+{
+  ++s->generation;
+  io_uring_sqe *sqe = getSqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  // EPOLLET对poll请求没有意义，multishot本身就只在状态变化时通知
+  sqe->poll32_events = s->events & ~static_cast<uint32_t>(EPOLLET);
+  if (s->multishot)
+  {
+    sqe->len = IORING_POLL_ADD_MULTI;
+  }
+  sqe->user_data = encodeUserData(fd, s->generation);
+  s->armed = true;
+}
+
+void IoUringPoller::disarm(int fd, Slot *s)
+{
+  if (s->armed)
+  {
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = encodeUserData(fd, s->generation);
+    sqe->user_data = kIgnoredUserData;
+    s->armed = false;
+  }
+  // 旧请求还没来得及收割的完成事件一律作废
+  ++s->generation;
+}
+
+void IoUringPoller::scheduleRearm(int fd, Slot *s)
+{
+  if (!s->rearm)
+  {
+    s->rearm = true;
+    rearmList_.push_back(fd);
+  }
+}
+
+int IoUringPoller::enter(unsigned toSubmit, bool wait, int timeoutMs)
+{
+  __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+  if (!wait)
+  {
+    return ioUringEnter(ringFd_, toSubmit, 0, 0, nullptr, _NSIG / 8);
+  }
+
+  __kernel_timespec ts;
+  io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof arg);
+  if (timeoutMs >= 0)
+  {
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+  }
+  return ioUringEnter(ringFd_, toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+}
+
+void IoUringPoller::reapCompletions(ChannelList *activeChannels)
+{
+  unsigned head = *cqHead_;
+  unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head)
+  {
+    const io_uring_cqe *cqe = &cqes_[head & *cqMask_];
+    if (cqe->user_data == kIgnoredUserData)
+    {
+      continue;
+    }
+    int fd = static_cast<int>(cqe->user_data >> 32);
+    if (static_cast<size_t>(fd) >= slots_.size())
+    {
+      continue;
+    }
+    Slot *s = &slots_[fd];
+    if (findChannel(fd) == nullptr || s->generation != static_cast<uint32_t>(cqe->user_data))
+    {
+      continue; // 已经被修改或移除的旧请求
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+    {
+      // 单次poll触发了，或者multishot被内核终止了，都需要重新挂上
+      s->armed = false;
+    }
+    if (cqe->res < 0)
+    {
+      LOG_ERROR("IoUringPoller poll fd=%d res=%d\n", fd, cqe->res);
+      if (s->armed)
+      {
+        continue;
+      }
+      // 请求结束了，不重新挂上这个fd就再也收不到事件：先重试一次，
+      // 重试还是失败就当作EPOLLERR交给channel的错误处理，不再自动重试
+      if (!s->failed)
+      {
+        s->failed = true;
+        scheduleRearm(fd, s);
+        continue;
+      }
+      s->revents |= EPOLLERR;
+      if (!s->active)
+      {
+        s->active = true;
+        activeFds_.push_back(fd);
+      }
+      continue;
+    }
+    s->failed = false;
+    s->revents |= static_cast<uint32_t>(cqe->res);
+    if (!s->active)
+    {
+      s->active = true;
+      activeFds_.push_back(fd);
+    }
+    if (!s->armed)
+    {
+      scheduleRearm(fd, s);
+    }
+  }
+  __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+  if (!activeFds_.empty())
+  {
+    LOG_STREAM(DEBUG) << activeFds_.size() << " events happened";
+  }
+  for (int fd : activeFds_)
+  {
+    Slot *s = &slots_[fd];
+    Channel *channel = channels_[fd];
+    channel->set_revents(static_cast<int>(s->revents));
+    activeChannels->push_back(channel);
+    s->revents = 0;
+    s->active = false;
+  }
+  activeFds_.clear();
+}
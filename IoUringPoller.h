@@ -0,0 +1,81 @@
+#pragma once
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <stdint.h>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// 基于io_uring的Poller，直接用系统调用，不依赖liburing
+// 仍然是就绪通知模型，对上层和EpollPoller完全一样：
+//   - 关注事件的增删改只是往SQ里填POLL_ADD/POLL_REMOVE，不立刻提交
+//   - poll()里一次io_uring_enter同时提交这一轮攒下的所有修改并等待完成事件
+// 边沿触发的channel(会读写到EAGAIN)用multishot poll，注册一次一直有效；
+// 水平触发的channel用单次poll，事件处理完之后在下一轮提交时重新挂上，
+// 重新挂上时如果fd仍然就绪会马上再次触发，语义和epoll的LT一致
+class IoUringPoller : public Poller
+{
+public:
+  explicit IoUringPoller(EventLoop *loop);
+  ~IoUringPoller() override;
+
+  // 内核是否支持这里用到的io_uring特性，结果只探测一次
+  static bool supported();
+
+  Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+  void updateChannel(Channel *channel) override;
+  void removeChannel(Channel *channel) override;
+
+private:
+  static const unsigned kRingEntries = 256;
+
+  // 每个fd一个槽位，和基类的channels_一样按fd下标，generation用来识别已经失效的完成事件
+  struct Slot
+  {
+    uint32_t generation;
+    uint32_t events;  // 当前挂在内核里的事件
+    uint32_t revents; // 本轮累计的就绪事件
+    bool armed;       // 内核里有一个有效的poll请求
+    bool multishot;
+    bool active;      // 已经放进本轮的activeChannels
+    bool rearm;       // 在rearmList_里等待重新挂上
+    bool failed;      // 上一个poll请求以错误结束，重新挂上后还没有成功过
+  };
+
+  Slot *slot(int fd);
+  io_uring_sqe *getSqe();
+  void arm(int fd, Slot *s);
+  void disarm(int fd, Slot *s);
+  void scheduleRearm(int fd, Slot *s);
+  // 提交SQ里的请求，wait为true时等待至少一个完成事件
+  int enter(unsigned toSubmit, bool wait, int timeoutMs);
+  void reapCompletions(ChannelList *activeChannels);
+
+  int ringFd_;
+  unsigned sqEntries_;
+
+  // SQ ring
+  void *sqRing_;
+  size_t sqRingSize_;
+  unsigned *sqHead_;
+  unsigned *sqTail_;
+  unsigned *sqMask_;
+  unsigned *sqArray_;
+  io_uring_sqe *sqes_;
+  size_t sqesSize_;
+  unsigned sqLocalTail_;
+
+  // CQ ring
+  void *cqRing_;
+  size_t cqRingSize_;
+  unsigned *cqHead_;
+  unsigned *cqTail_;
+  unsigned *cqMask_;
+  io_uring_cqe *cqes_;
+
+  std::vector<Slot> slots_;
+  std::vector<int> rearmList_;
+  std::vector<int> activeFds_;
+};
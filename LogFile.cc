@@ -0,0 +1,159 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "LogFile.h"
+
+LogFile::LogFile(const std::string &basename,
+                 off_t rollSize,
+                 bool threadSafe,
+                 int flushInterval,
+                 int checkEveryN)
+    : basename_(basename),
+      rollSize_(rollSize),
+      flushInterval_(flushInterval),
+      checkEveryN_(checkEveryN),
+      count_(0),
+      mutex_(threadSafe ? new std::mutex : nullptr),
+      startOfPeriod_(0),
+      lastRoll_(0),
+      lastFlush_(0),
+      fp_(nullptr),
+      writtenBytes_(0)
+{
+  rollFile();
+}
+
+LogFile::~LogFile()
+{
+  if (fp_)
+  {
+    ::fclose(fp_);
+  }
+}
+
+void LogFile::append(const char *logline, int len)
+{
+  if (mutex_)
+  {
+    std::unique_lock<std::mutex> lock(*mutex_);
+    append_unlocked(logline, len);
+  }
+  else
+  {
+    append_unlocked(logline, len);
+  }
+}
+
+void LogFile::flush()
+{
+  if (mutex_)
+  {
+    std::unique_lock<std::mutex> lock(*mutex_);
+    ::fflush(fp_);
+  }
+  else
+  {
+    ::fflush(fp_);
+  }
+}
+
+void LogFile::append_unlocked(const char *logline, int len)
+{
+  if (fp_ == nullptr)
+  {
+    return;
+  }
+  size_t written = 0;
+  while (written != static_cast<size_t>(len))
+  {
+    size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+    if (n == 0)
+    {
+      int err = ::ferror(fp_);
+      if (err)
+      {
+        fprintf(stderr, "LogFile::append() failed %s\n", strerror(err));
+      }
+      break;
+    }
+    written += n;
+  }
+  writtenBytes_ += written;
+
+  if (writtenBytes_ > rollSize_)
+  {
+    rollFile();
+  }
+  else if (++count_ >= checkEveryN_)
+  {
+    // 不是每次都取时间，每写checkEveryN_次检查一次是否跨天/是否需要flush
+    count_ = 0;
+    time_t now = ::time(NULL);
+    time_t thisPeriod = now / kRollPerSeconds_ * kRollPerSeconds_;
+    if (thisPeriod != startOfPeriod_)
+    {
+      rollFile();
+    }
+    else if (now - lastFlush_ > flushInterval_)
+    {
+      lastFlush_ = now;
+      ::fflush(fp_);
+    }
+  }
+}
+
+bool LogFile::rollFile()
+{
+  time_t now = 0;
+  std::string filename = getLogFileName(basename_, &now);
+  time_t start = now / kRollPerSeconds_ * kRollPerSeconds_;
+
+  // 同一秒内不重复滚动，否则文件名会重复
+  if (now > lastRoll_)
+  {
+    FILE *fp = ::fopen(filename.c_str(), "ae");
+    if (fp == nullptr)
+    {
+      fprintf(stderr, "LogFile::rollFile() open %s failed:%d\n", filename.c_str(), errno);
+      return false;
+    }
+    if (fp_)
+    {
+      ::fclose(fp_);
+    }
+    fp_ = fp;
+    ::setbuffer(fp_, buffer_, sizeof buffer_);
+    lastRoll_ = now;
+    lastFlush_ = now;
+    startOfPeriod_ = start;
+    writtenBytes_ = 0;
+    return true;
+  }
+  return false;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t *now)
+{
+  std::string filename;
+  filename.reserve(basename.size() + 64);
+  filename = basename;
+
+  char timebuf[32];
+  struct tm tm;
+  *now = time(NULL);
+  localtime_r(now, &tm);
+  strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+  filename += timebuf;
+
+  char hostname[256] = "unknownhost";
+  ::gethostname(hostname, sizeof hostname - 1);
+  filename += hostname;
+
+  char pidbuf[32];
+  snprintf(pidbuf, sizeof pidbuf, ".%d", ::getpid());
+  filename += pidbuf;
+
+  filename += ".log";
+  return filename;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <mutex>
+#include <memory>
+
+#include "noncopyable.h"
+
+// 日志文件，按大小和按天滚动
+// 文件名: basename.年月日-时分秒.主机名.进程号.log
+class LogFile : noncopyable
+{
+public:
+  LogFile(const std::string &basename,
+          off_t rollSize,
+          bool threadSafe = true,
+          int flushInterval = 3,
+          int checkEveryN = 1024);
+  ~LogFile();
+
+  void append(const char *logline, int len);
+  void flush();
+  bool rollFile();
+
+private:
+  void append_unlocked(const char *logline, int len);
+
+  static std::string getLogFileName(const std::string &basename, time_t *now);
+
+  const std::string basename_;
+  const off_t rollSize_;     // 单个文件写满多少字节后滚动
+  const int flushInterval_;  // 多少秒flush一次
+  const int checkEveryN_;    // 每写多少次检查一次时间
+
+  int count_;
+
+  std::unique_ptr<std::mutex> mutex_;
+  time_t startOfPeriod_; // 当前文件所属的那一天(零点)
+  time_t lastRoll_;
+  time_t lastFlush_;
+  FILE *fp_;
+  off_t writtenBytes_;
+  char buffer_[64 * 1024]; // 用户态写缓冲
+
+  static const int kRollPerSeconds_ = 60 * 60 * 24;
+};
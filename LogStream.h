@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+
+#include "noncopyable.h"
+#include "FixedBuffer.h"
+
+// 流式日志格式化，直接写进定长缓冲区，整个过程不分配内存
+// 整数和指针走手写的转换，不经过snprintf
+class LogStream : noncopyable
+{
+public:
+  using Buffer = FixedBuffer<kSmallBuffer>;
+
+  LogStream &operator<<(bool v)
+  {
+    buffer_.append(v ? "1" : "0", 1);
+    return *this;
+  }
+
+  LogStream &operator<<(short);
+  LogStream &operator<<(unsigned short);
+  LogStream &operator<<(int);
+  LogStream &operator<<(unsigned int);
+  LogStream &operator<<(long);
+  LogStream &operator<<(unsigned long);
+  LogStream &operator<<(long long);
+  LogStream &operator<<(unsigned long long);
+
+  // 指针按十六进制输出
+  LogStream &operator<<(const void *);
+
+  LogStream &operator<<(float v)
+  {
+    *this << static_cast<double>(v);
+    return *this;
+  }
+  LogStream &operator<<(double);
+
+  LogStream &operator<<(char v)
+  {
+    buffer_.append(&v, 1);
+    return *this;
+  }
+
+  LogStream &operator<<(const char *str)
+  {
+    if (str)
+    {
+      buffer_.append(str, strlen(str));
+    }
+    else
+    {
+      buffer_.append("(null)", 6);
+    }
+    return *this;
+  }
+
+  LogStream &operator<<(const std::string &v)
+  {
+    buffer_.append(v.data(), v.size());
+    return *this;
+  }
+
+  // 兼容原有的printf风格日志，直接格式化到缓冲区剩余空间里，不再经过中间拷贝
+  LogStream &appendf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  void append(const char *data, int len) { buffer_.append(data, len); }
+  const Buffer &buffer() const { return buffer_; }
+  void resetBuffer() { buffer_.reset(); }
+
+private:
+  template <typename T>
+  void formatInteger(T);
+
+  Buffer buffer_;
+
+  static const int kMaxNumericSize = 48;
+};
@@ -1,38 +1,82 @@
-#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
 #include "Logger.h"
 #include "Timestamp.h"
-// 获取唯一实例
-Logger &Logger::instance()
+
+// 每个线程缓存格式化好的日期前缀，只有秒数变化时才重新调用localtime_r
+__thread time_t t_lastSecond = 0;
+__thread char t_time[32];
+__thread int t_timeLen = 0;
+
+static void defaultOutput(const char *msg, int len)
+{
+  // 不在每一行后面flush，交给stdio自己的缓冲
+  fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush()
+{
+  fflush(stdout);
+}
+
+std::atomic_int Logger::logLevel_(INFO);
+Logger::OutputFunc Logger::output_ = defaultOutput;
+Logger::FlushFunc Logger::flush_ = defaultFlush;
+
+void Logger::setLogLevel(LogLevel level)
+{
+  logLevel_.store(level, std::memory_order_relaxed);
+}
+
+void Logger::setOutput(OutputFunc out)
 {
-  static Logger logger;
-  return logger;
+  output_ = out;
 }
 
-void Logger::setLogLevel(int level)
+void Logger::setFlush(FlushFunc flush)
 {
-  logLevel_ = level;
+  flush_ = flush;
 }
 
-void Logger::log(std::string message)
+static const char *const kLevelName[] = {
+    "[DEBUG] ",
+    "[INFO] ",
+    "[ERROR] ",
+    "[FATAL] ",
+};
+
+static const int kLevelNameLen[] = {8, 7, 8, 8};
+
+LogMessage::LogMessage(LogLevel level)
+    : level_(level)
 {
+  time_t seconds = Timestamp::now().secondsSinceEpoch();
+  if (seconds != t_lastSecond)
+  {
+    t_lastSecond = seconds;
+    struct tm tm_time;
+    localtime_r(&seconds, &tm_time);
+    t_timeLen = snprintf(t_time, sizeof t_time, "%4d-%02d-%02d %02d:%02d:%02d : ",
+                         tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                         tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+  }
+  stream_.append(kLevelName[level], kLevelNameLen[level]);
+  stream_.append(t_time, t_timeLen);
+}
 
-  switch (logLevel_)
+LogMessage::~LogMessage()
+{
+  // 兼容原有日志格式串末尾自带的换行
+  const LogStream::Buffer &buf(stream_.buffer());
+  if (buf.length() == 0 || buf.data()[buf.length() - 1] != '\n')
   {
-  case INFO:
-    std::cout << "[INFO] ";
-    break;
-  case ERROR:
-    std::cout << "[ERROR] ";
-    break;
-  case FATAL:
-    std::cout << "[FATAL] ";
-    break;
-  case DEBUG:
-    std::cout << "[DEBUG] ";
-    break;
-  default:
-    std::cout << "[INFO] ";
-    break;
+    stream_ << '\n';
   }
-  std::cout << Timestamp::now().toString() << " : " << message << std::endl;
-}
\ No newline at end of file
+  Logger::output_(buf.data(), buf.length());
+  if (level_ == FATAL)
+  {
+    Logger::flush_();
+  }
+}
@@ -1,74 +1,89 @@
 #pragma once
+#include <atomic>
 #include <string>
 #include "noncopyable.h"
+#include "LogStream.h"
 
-#define LOG_INFO(logmsgFormat, ...)                   \
-  do                                                  \
-  {                                                   \
-    Logger &logger = Logger::instance();              \
-    logger.setLogLevel(INFO);                         \
-    char buf[1024];                                   \
-    snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-    logger.log(buf);                                  \
-  } while (0)
-
-#define LOG_ERROR(logmsgFormat, ...)                  \
-  do                                                  \
-  {                                                   \
-    Logger &logger = Logger::instance();              \
-    logger.setLogLevel(ERROR);                        \
-    char buf[1024];                                   \
-    snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-    logger.log(buf);                                  \
-  } while (0)
-
-#define LOG_FATAL(logmsgFormat, ...)                  \
-  do                                                  \
-  {                                                   \
-    Logger &logger = Logger::instance();              \
-    logger.setLogLevel(FATAL);                        \
-    char buf[1024];                                   \
-    snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-    logger.log(buf);                                  \
-  } while (0)
-
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...)                  \
-  do                                                  \
-  {                                                   \
-    Logger &logger = Logger::instance();              \
-    logger.setLogLevel(DEBUG);                        \
-    char buf[1024];                                   \
-    snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-    logger.log(buf);                                  \
-  } while (0)
-#else
-#define LOG_DEBUG(logmsgFormat, ...) \
-  do                                 \
-  {                                  \
-  } while (0)
-#endif
-// 定义日志级别 INFO ERROR FATAl DEBUG
+// 定义日志级别 DEBUG INFO ERROR FATAL，数值越大越重要
 enum LogLevel
 {
+  DEBUG,
   INFO,
   ERROR,
-  FATAL,
-  DEBUG
+  FATAL
 };
 
-// 输出一个日志类
+// 编译期的日志级别下限，低于它的日志语句连同参数求值一起被编译器消除
+// 定义了MUDEBUG时保留DEBUG日志，否则从INFO开始
+#ifndef MULOG_MIN_LEVEL
+#ifdef MUDEBUG
+#define MULOG_MIN_LEVEL DEBUG
+#else
+#define MULOG_MIN_LEVEL INFO
+#endif
+#endif
+
+// 先比较编译期常量，再读一次运行期级别，关闭的日志只有一次比较的开销
+#define LOG_ENABLED(level) \
+  ((level) >= MULOG_MIN_LEVEL && (level) >= Logger::logLevel())
+
+// 流式写法: LOG_STREAM(INFO) << "fd=" << fd;
+#define LOG_STREAM(level)      \
+  if (!LOG_ENABLED(level))     \
+  {                            \
+  }                            \
+  else                         \
+    LogMessage(level).stream()
+
+// printf风格写法，直接格式化进LogMessage的定长缓冲区
+#define LOG_INFO(logmsgFormat, ...) \
+  LOG_STREAM(INFO).appendf(logmsgFormat, ##__VA_ARGS__)
+
+#define LOG_ERROR(logmsgFormat, ...) \
+  LOG_STREAM(ERROR).appendf(logmsgFormat, ##__VA_ARGS__)
+
+#define LOG_FATAL(logmsgFormat, ...) \
+  LOG_STREAM(FATAL).appendf(logmsgFormat, ##__VA_ARGS__)
+
+#define LOG_DEBUG(logmsgFormat, ...) \
+  LOG_STREAM(DEBUG).appendf(logmsgFormat, ##__VA_ARGS__)
+
+// 日志的全局配置
 class Logger : noncopyable
 {
 public:
-  // 获取单例对象
-  static Logger &instance();
-  // 设置日志级别
-  void setLogLevel(int level);
-  // 写日志
-  void log(std::string message);
+  // 日志的输出目的地，默认写到stdout，接入AsyncLogging时设置为它的append
+  using OutputFunc = void (*)(const char *msg, int len);
+  using FlushFunc = void (*)();
+
+  // 运行期的最低日志级别，默认INFO
+  static LogLevel logLevel()
+  {
+    return static_cast<LogLevel>(logLevel_.load(std::memory_order_relaxed));
+  }
+  static void setLogLevel(LogLevel level);
+
+  // 在启动其他线程之前设置
+  static void setOutput(OutputFunc out);
+  static void setFlush(FlushFunc flush);
+
+private:
+  friend class LogMessage;
+  static std::atomic_int logLevel_;
+  static OutputFunc output_;
+  static FlushFunc flush_;
+};
+
+// 一条日志，构造时写入级别和时间前缀，析构时把整行交给输出端
+class LogMessage : noncopyable
+{
+public:
+  explicit LogMessage(LogLevel level);
+  ~LogMessage();
+
+  LogStream &stream() { return stream_; }
 
 private:
-  int logLevel_;
-  Logger() {};
-};
\ No newline at end of file
+  LogLevel level_;
+  LogStream stream_;
+};
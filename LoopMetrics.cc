@@ -0,0 +1,23 @@
+#include "LoopMetrics.h"
+
+const int MetricHistogram::kBuckets;
+
+MetricHistogram::MetricHistogram()
+    : sum_(0)
+{
+  for (int i = 0; i < kBuckets; ++i)
+  {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void MetricHistogram::snapshot(Snapshot *snap) const
+{
+  snap->count = 0;
+  for (int i = 0; i < kBuckets; ++i)
+  {
+    snap->counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    snap->count += snap->counts[i];
+  }
+  snap->sum = sum_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include "noncopyable.h"
+
+// loop的运行指标，只有loop线程写，任意线程可以随时读，读写都不加锁
+// 单写者不需要原子的read-modify-write，load之后store即可，在x86上就是普通的mov
+class MetricCounter : noncopyable
+{
+public:
+  MetricCounter() : value_(0) {}
+
+  // 只能在loop线程中调用
+  void add(uint64_t n)
+  {
+    value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value_;
+};
+
+// 按2的幂分桶的直方图，第i个桶统计 (2^(i-1), 2^i] 的值，第0个桶统计0和1，
+// 最后一个桶统计所有更大的值；读取时各个桶之间不保证是同一时刻的
+class MetricHistogram : noncopyable
+{
+public:
+  static const int kBuckets = 32;
+
+  struct Snapshot
+  {
+    uint64_t counts[kBuckets];
+    uint64_t count;
+    uint64_t sum;
+  };
+
+  MetricHistogram();
+
+  // 只能在loop线程中调用
+  void record(uint64_t value)
+  {
+    std::atomic<uint64_t> &bucket = buckets_[bucketOf(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  void snapshot(Snapshot *snap) const;
+
+  // 第i个桶的上界
+  static uint64_t upperBound(int bucket) { return static_cast<uint64_t>(1) << bucket; }
+
+  static int bucketOf(uint64_t value)
+  {
+    if (value <= 1)
+    {
+      return 0;
+    }
+    int bucket = 64 - __builtin_clzll(value - 1);
+    return bucket < kBuckets ? bucket : kBuckets - 1;
+  }
+
+private:
+  std::atomic<uint64_t> buckets_[kBuckets];
+  std::atomic<uint64_t> sum_;
+};
+
+// 每个EventLoop一份，时间都以微秒为单位
+struct LoopMetrics : noncopyable
+{
+  MetricCounter iterations;       // loop循环的轮数
+  MetricCounter events;           // poll返回的事件总数
+  MetricHistogram eventsPerPoll;  // 每次poll返回的事件数
+  MetricHistogram pollTime;       // 每轮在poll里的时间，包括阻塞等待
+  MetricHistogram handlerTime;    // 每轮处理活跃channel的时间
+  MetricHistogram functorTime;    // 每轮执行pendingFunctors的时间
+  MetricHistogram functorsPerRun; // 每轮取出的pendingFunctors个数，即当时的队列深度
+  MetricCounter functors;         // 执行过的pendingFunctors总数
+  MetricCounter bytesRead;        // 本loop上所有连接读到的字节数
+  MetricCounter bytesWritten;     // 本loop上所有连接写出的字节数
+};
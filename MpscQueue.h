@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+
+#include "noncopyable.h"
+
+// 侵入式无锁多生产者单消费者队列(Vyukov)
+// 元素自己继承MpscNode，入队不分配内存，一次原子交换即可
+// push可以在任意线程调用，pop只能在唯一的消费者线程调用
+struct MpscNode
+{
+  std::atomic<MpscNode *> next_;
+};
+
+class MpscQueue : noncopyable
+{
+public:
+  MpscQueue()
+      : head_(&stub_),
+        tail_(&stub_)
+  {
+    stub_.next_.store(nullptr, std::memory_order_relaxed);
+  }
+
+  void push(MpscNode *node)
+  {
+    node->next_.store(nullptr, std::memory_order_relaxed);
+    MpscNode *prev = head_.exchange(node, std::memory_order_acq_rel);
+    // 这里到下一行之间消费者看到的链表是断开的，pop会返回nullptr
+    prev->next_.store(node, std::memory_order_release);
+  }
+
+  // 队列为空或者有生产者正在入队时返回nullptr
+  MpscNode *pop()
+  {
+    MpscNode *tail = tail_;
+    MpscNode *next = tail->next_.load(std::memory_order_acquire);
+    if (tail == &stub_)
+    {
+      if (next == nullptr)
+      {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next_.load(std::memory_order_acquire);
+    }
+    if (next)
+    {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+    // tail是最后一个元素，把stub放回去才能把它取出来
+    push(&stub_);
+    next = tail->next_.load(std::memory_order_acquire);
+    if (next)
+    {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+  // 只在消费者线程里有意义
+  bool empty() const
+  {
+    return tail_ == &stub_ && stub_.next_.load(std::memory_order_acquire) == nullptr;
+  }
+
+private:
+  std::atomic<MpscNode *> head_; // 生产者端
+  MpscNode *tail_;               // 消费者端
+  MpscNode stub_;
+};
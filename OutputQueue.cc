@@ -0,0 +1,235 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "OutputQueue.h"
+#include "BufferPool.h"
+
+const size_t OutputQueue::kCopyThreshold;
+const size_t OutputQueue::kChunkSize;
+
+// 一次writev最多提交的段数
+static const int kMaxIovecs = IOV_MAX;
+
+OutputQueue::OutputQueue(BufferPool *pool)
+    : pool_(pool),
+      readableBytes_(0),
+      bufferedBytes_(0)
+{
+}
+
+OutputQueue::~OutputQueue()
+{
+  retrieveAll();
+}
+
+void OutputQueue::append(const char *data, size_t len)
+{
+  if (len == 0)
+  {
+    return;
+  }
+  readableBytes_ += len;
+  bufferedBytes_ += len;
+
+  if (!segments_.empty())
+  {
+    Segment &tail = segments_.back();
+    // 尾部的拷贝段还有空间就合并进去，避免产生很多小段
+    size_t used = tail.offset + tail.len;
+    if (tail.isCopied() && used + len <= tail.chunkCapacity)
+    {
+      memcpy(tail.chunk + used, data, len);
+      tail.len += len;
+      return;
+    }
+  }
+
+  segments_.push_back(Segment());
+  Segment &seg = segments_.back();
+  size_t want = std::max(len, kChunkSize);
+  if (pool_)
+  {
+    seg.chunk = pool_->allocate(want, &seg.chunkCapacity);
+  }
+  else
+  {
+    seg.chunk = static_cast<char *>(::malloc(want));
+    seg.chunkCapacity = want;
+  }
+  memcpy(seg.chunk, data, len);
+  seg.len = len;
+}
+
+void OutputQueue::append(std::string &&str, size_t offset)
+{
+  if (offset >= str.size())
+  {
+    return;
+  }
+  size_t len = str.size() - offset;
+  if (len < kCopyThreshold)
+  {
+    append(str.data() + offset, len);
+    return;
+  }
+  readableBytes_ += len;
+  bufferedBytes_ += len;
+  segments_.push_back(Segment());
+  Segment &seg = segments_.back();
+  seg.str = std::move(str);
+  seg.offset = offset;
+  seg.len = len;
+}
+
+void OutputQueue::append(const std::shared_ptr<const void> &holder, const char *data, size_t len)
+{
+  if (len == 0)
+  {
+    return;
+  }
+  if (len < kCopyThreshold)
+  {
+    append(data, len);
+    return;
+  }
+  readableBytes_ += len;
+  bufferedBytes_ += len;
+  segments_.push_back(Segment());
+  Segment &seg = segments_.back();
+  seg.holder = holder;
+  seg.ptr = data;
+  seg.len = len;
+}
+
+void OutputQueue::appendFile(int fd, off_t offset, size_t len)
+{
+  if (len == 0)
+  {
+    ::close(fd);
+    return;
+  }
+  readableBytes_ += len;
+  segments_.push_back(Segment());
+  Segment &seg = segments_.back();
+  seg.fileFd = fd;
+  seg.fileOffset = offset;
+  seg.len = len;
+}
+
+void OutputQueue::popFront()
+{
+  Segment &seg = segments_.front();
+  readableBytes_ -= seg.len;
+  if (seg.isFile())
+  {
+    ::close(seg.fileFd);
+  }
+  else
+  {
+    bufferedBytes_ -= seg.len;
+    if (seg.isCopied())
+    {
+      if (pool_)
+      {
+        pool_->deallocate(seg.chunk, seg.chunkCapacity);
+      }
+      else
+      {
+        ::free(seg.chunk);
+      }
+    }
+  }
+  segments_.pop_front();
+}
+
+void OutputQueue::retrieve(size_t len)
+{
+  len = std::min(len, readableBytes_);
+  while (len > 0)
+  {
+    Segment &seg = segments_.front();
+    if (len < seg.len)
+    {
+      seg.offset += len;
+      seg.len -= len;
+      readableBytes_ -= len;
+      if (!seg.isFile())
+      {
+        bufferedBytes_ -= len;
+      }
+      break;
+    }
+    len -= seg.len;
+    popFront();
+  }
+}
+
+void OutputQueue::retrieveAll()
+{
+  while (!segments_.empty())
+  {
+    popFront();
+  }
+}
+
+ssize_t OutputQueue::sendFileSegment(int fd, int *saveErrno)
+{
+  Segment &seg = segments_.front();
+  off_t offset = seg.fileOffset + static_cast<off_t>(seg.offset);
+  ssize_t n = ::sendfile(fd, seg.fileFd, &offset, seg.len);
+  if (n < 0)
+  {
+    *saveErrno = errno;
+  }
+  else if (n == 0)
+  {
+    // 文件比声明的长度短(被截断了)，剩下的部分无法发送，直接丢弃
+    popFront();
+  }
+  else
+  {
+    retrieve(n);
+  }
+  return n;
+}
+
+ssize_t OutputQueue::writeFd(int fd, int *saveErrno)
+{
+  if (!segments_.empty() && segments_.front().isFile())
+  {
+    return sendFileSegment(fd, saveErrno);
+  }
+
+  // 文件段之前的内存段合并成一次writev，保证和文件内容的先后顺序
+  struct iovec vec[kMaxIovecs];
+  int iovcnt = 0;
+  for (std::deque<Segment>::const_iterator it = segments_.begin();
+       it != segments_.end() && iovcnt < kMaxIovecs && !it->isFile(); ++it)
+  {
+    vec[iovcnt].iov_base = const_cast<char *>(it->data());
+    vec[iovcnt].iov_len = it->len;
+    ++iovcnt;
+  }
+  if (iovcnt == 0)
+  {
+    return 0;
+  }
+
+  ssize_t n = ::writev(fd, vec, iovcnt);
+  if (n < 0)
+  {
+    *saveErrno = errno;
+  }
+  else
+  {
+    retrieve(n);
+  }
+  return n;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <sys/types.h>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "noncopyable.h"
+
+class BufferPool;
+
+// 发送缓冲，由若干段组成的链表，刷新时用writev一次交给内核
+// 每一段可以是：
+//   拷贝进来的小块数据，相邻的小块合并到同一段里，内存从BufferPool中取，发送完就归还
+//   move进来的std::string，不拷贝
+//   由shared_ptr持有的一段共享内存，不拷贝，发送完成后释放引用
+//   文件中的一段区域，轮到它时用sendfile发送，数据不经过用户态
+// 只在所属loop线程中使用
+class OutputQueue : noncopyable
+{
+public:
+  // 小于这个长度的数据直接拷贝，合并后再一起发送
+  static const size_t kCopyThreshold = 1024;
+  // 拷贝段的容量
+  static const size_t kChunkSize = 4096;
+
+  // pool为空时使用malloc/free，pool的生命周期需要长于OutputQueue
+  explicit OutputQueue(BufferPool *pool = nullptr);
+  ~OutputQueue();
+
+  // 拷贝data
+  void append(const char *data, size_t len);
+  // 接管str，从offset开始的部分待发送
+  void append(std::string &&str, size_t offset = 0);
+  // 共享一段内存，holder保证[data, data+len)在发送完之前有效
+  void append(const std::shared_ptr<const void> &holder, const char *data, size_t len);
+  // 接管文件描述符fd，发送其中[offset, offset+len)的内容，发送完或者丢弃时关闭fd
+  void appendFile(int fd, off_t offset, size_t len);
+
+  // 待发送的总字节数，包括文件区域
+  size_t readableBytes() const { return readableBytes_; }
+  // 占用内存的待发送字节数，不包括文件区域，高水位按它计算
+  size_t bufferedBytes() const { return bufferedBytes_; }
+  bool empty() const { return readableBytes_ == 0; }
+
+  // 丢弃前len个字节
+  void retrieve(size_t len);
+  void retrieveAll();
+
+  // 队首是文件区域时调用一次sendfile，否则用writev把文件区域之前尽可能多的段写到fd上
+  // 写成功的部分会被retrieve
+  ssize_t writeFd(int fd, int *saveErrno);
+
+private:
+  struct Segment
+  {
+    Segment()
+        : ptr(nullptr),
+          offset(0),
+          len(0),
+          chunk(nullptr),
+          chunkCapacity(0),
+          fileFd(-1),
+          fileOffset(0)
+    {
+    }
+
+    bool isFile() const { return fileFd >= 0; }
+    bool isCopied() const { return chunk != nullptr; }
+    const char *data() const
+    {
+      return (chunk ? chunk : (holder ? ptr : str.data())) + offset;
+    }
+
+    std::string str;                     // 接管的字符串
+    std::shared_ptr<const void> holder;  // 共享段的所有者
+    const char *ptr;                     // 共享段的起始地址
+    size_t offset;                       // 已经发送的字节数
+    size_t len;                          // 剩余待发送的字节数
+    char *chunk;                         // 拷贝段的内存，可以继续往后追加
+    size_t chunkCapacity;
+    int fileFd;                          // 文件段的描述符
+    off_t fileOffset;                    // 文件段在文件中的起始位置
+  };
+
+  // 弹出队首，拷贝段归还内存，文件段关闭描述符
+  void popFront();
+  ssize_t sendFileSegment(int fd, int *saveErrno);
+
+  BufferPool *pool_;
+  std::deque<Segment> segments_;
+  size_t readableBytes_;
+  size_t bufferedBytes_;
+};
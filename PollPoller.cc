@@ -0,0 +1,141 @@
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+
+#include "PollPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+namespace
+{
+  const int kNew = -1;
+
+  // 注册的事件转换成poll用的掩码，Channel的事件值和poll的定义相同，只需要去掉EPOLLET
+  short toPollEvents(const Channel *channel)
+  {
+    int events = channel->events() & ~EPOLLET;
+    if (channel->edgeTriggered() && !channel->isWriting())
+    {
+      events &= ~EPOLLOUT;
+    }
+    return static_cast<short>(events);
+  }
+}
+
+PollPoller::PollPoller(EventLoop *loop)
+    : Poller(loop),
+      numEdgeTriggered_(0)
+{
+}
+
+PollPoller::~PollPoller() = default;
+
+Timestamp PollPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+  LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, pollfds_.size());
+
+  if (numEdgeTriggered_ > 0)
+  {
+    syncEdgeTriggeredEvents();
+  }
+  ++pollCalls_;
+  int numEvents = ::poll(pollfds_.data(), pollfds_.size(), timeoutMs);
+  int saveErrno = errno;
+  Timestamp now(Timestamp::now());
+
+  if (numEvents > 0)
+  {
+    LOG_STREAM(DEBUG) << numEvents << " events happened";
+    fillActiveChannels(numEvents, activeChannels);
+  }
+  else if (numEvents == 0)
+  {
+    LOG_DEBUG("%s timeout! \n", __FUNCTION__);
+  }
+  else if (saveErrno != EINTR)
+  {
+    errno = saveErrno;
+    LOG_ERROR("PollPoller::poll() err!");
+  }
+  return now;
+}
+
+void PollPoller::updateChannel(Channel *channel)
+{
+  LOG_STREAM(DEBUG) << "updateChannel fd=" << channel->fd() << " events=" << channel->events() << " index=" << channel->index();
+  if (channel->index() == kNew)
+  {
+    struct pollfd pfd;
+    pfd.fd = channel->fd();
+    pfd.events = toPollEvents(channel);
+    pfd.revents = 0;
+    pollfds_.push_back(pfd);
+    pollChannels_.push_back(channel);
+    channel->set_index(static_cast<int>(pollfds_.size()) - 1);
+    setChannel(pfd.fd, channel);
+    if (channel->edgeTriggered())
+    {
+      ++numEdgeTriggered_;
+    }
+  }
+  else
+  {
+    struct pollfd &pfd = pollfds_[channel->index()];
+    pfd.events = toPollEvents(channel);
+    pfd.revents = 0;
+    // 不关心任何事件时把fd取反，poll会跳过负数fd，不用从数组里删掉
+    pfd.fd = channel->isNoneEvent() ? -channel->fd() - 1 : channel->fd();
+  }
+}
+
+void PollPoller::removeChannel(Channel *channel)
+{
+  LOG_STREAM(DEBUG) << "removeChannel fd=" << channel->fd();
+  int idx = channel->index();
+  if (idx == kNew)
+  {
+    return;
+  }
+  clearChannel(channel->fd());
+  size_t last = pollfds_.size() - 1;
+  if (static_cast<size_t>(idx) != last)
+  {
+    // 把最后一个换过来，更新它的下标
+    pollfds_[idx] = pollfds_[last];
+    pollChannels_[idx] = pollChannels_[last];
+    pollChannels_[idx]->set_index(idx);
+  }
+  pollfds_.pop_back();
+  pollChannels_.pop_back();
+  if (channel->edgeTriggered())
+  {
+    --numEdgeTriggered_;
+  }
+  channel->set_index(kNew);
+}
+
+void PollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels) const
+{
+  for (size_t i = 0; i < pollfds_.size() && numEvents > 0; ++i)
+  {
+    if (pollfds_[i].revents > 0)
+    {
+      --numEvents;
+      Channel *channel = pollChannels_[i];
+      channel->set_revents(pollfds_[i].revents);
+      activeChannels->push_back(channel);
+    }
+  }
+}
+
+void PollPoller::syncEdgeTriggeredEvents()
+{
+  for (size_t i = 0; i < pollfds_.size(); ++i)
+  {
+    const Channel *channel = pollChannels_[i];
+    if (channel->edgeTriggered() && pollfds_[i].fd >= 0)
+    {
+      pollfds_[i].events = toPollEvents(channel);
+    }
+  }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <vector>
+
+struct pollfd;
+
+// 基于poll(2)的Poller，设置环境变量MUDUO_USE_POLL时使用
+// pollfds_是紧凑数组，channel的index就是它在数组里的下标，
+// 删除时把最后一个元素换到空位上，增删改都是O(1)
+class PollPoller : public Poller
+{
+public:
+  explicit PollPoller(EventLoop *loop);
+  ~PollPoller() override;
+
+  Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+  void updateChannel(Channel *channel) override;
+  void removeChannel(Channel *channel) override;
+
+private:
+  void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
+  // poll只有水平触发，边沿触发的channel常驻的可写事件要按isWriting()临时去掉，否则会空转
+  void syncEdgeTriggeredEvents();
+
+  std::vector<struct pollfd> pollfds_;
+  std::vector<Channel *> pollChannels_; // 和pollfds_下标一一对应
+  int numEdgeTriggered_;
+};
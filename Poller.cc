@@ -1,6 +1,13 @@
+#include <algorithm>
+
 #include "Poller.h"
 #include "Channel.h"
-Poller::Poller(EventLoop *loop) : ownerLoop_(loop)
+Poller::Poller(EventLoop *loop)
+    : numChannels_(0),
+      pollCalls_(0),
+      ctlCalls_(0),
+      ctlSaved_(0),
+      ownerLoop_(loop)
 {
 }
 
@@ -9,6 +16,28 @@ Poller::~Poller() = default;
 bool Poller::hasChannel(Channel *channel) const
 {
   // assertInLoopThread();
-  auto it = channels_.find(channel->fd());
-  return it != channels_.end() && it->second == channel;
+  return findChannel(channel->fd()) == channel;
+}
+
+void Poller::setChannel(int fd, Channel *channel)
+{
+  if (static_cast<size_t>(fd) >= channels_.size())
+  {
+    // 按倍数扩容，fd上限由RLIMIT_NOFILE决定，不会无限增长
+    channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2), nullptr);
+  }
+  if (channels_[fd] == nullptr)
+  {
+    ++numChannels_;
+  }
+  channels_[fd] = channel;
+}
+
+void Poller::clearChannel(int fd)
+{
+  if (static_cast<size_t>(fd) < channels_.size() && channels_[fd] != nullptr)
+  {
+    channels_[fd] = nullptr;
+    --numChannels_;
+  }
 }
\ No newline at end of file
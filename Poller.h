@@ -1,7 +1,8 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
 #include <vector>
-#include <unordered_map>
 #include "noncopyable.h"
 
 class Channel;
@@ -24,11 +25,27 @@ public:
   // Eventloop
   static Poller *newDefaultPoller(EventLoop *loop);
 
-
+  // 系统调用计数，只在loop线程里更新
+  uint64_t pollCalls() const { return pollCalls_; } // 等待事件(epoll_wait等)的次数
+  uint64_t ctlCalls() const { return ctlCalls_; }   // 修改关注事件(epoll_ctl等)的次数
+  uint64_t ctlCallsSaved() const { return ctlSaved_; } // 合并或抵消掉、没有真正发出的修改次数
 
 protected:
-  using ChannelMap = std::unordered_map<int, Channel *>;
-  ChannelMap channels_;
+  // fd是小而稠密的整数，直接按fd下标存channel，
+  // 查找是一次数组访问，连接频繁建立断开时也没有哈希表节点的分配释放
+  Channel *findChannel(int fd) const
+  {
+    return static_cast<size_t>(fd) < channels_.size() ? channels_[fd] : nullptr;
+  }
+  void setChannel(int fd, Channel *channel);
+  void clearChannel(int fd);
+
+  using ChannelTable = std::vector<Channel *>;
+  ChannelTable channels_;
+  size_t numChannels_;
+  uint64_t pollCalls_;
+  uint64_t ctlCalls_;
+  uint64_t ctlSaved_;
 
 private:
   EventLoop *ownerLoop_;
@@ -8,6 +8,8 @@
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <errno.h>
+#include <linux/filter.h>
 
 Socket::~Socket()
 {
@@ -75,4 +77,35 @@ void Socket::setKeepAlive(bool on)
 {
   int optval = on ? 1 : 0;
   ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
-}
\ No newline at end of file
+}
+
+void Socket::setBusyPoll(int microSeconds)
+{
+  if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &microSeconds, sizeof microSeconds) < 0)
+  {
+    LOG_ERROR("SO_BUSY_POLL sockfd: %d fail, errno: %d \n", sockfd_, errno);
+  }
+#ifdef SO_PREFER_BUSY_POLL
+  int optval = microSeconds > 0 ? 1 : 0;
+  ::setsockopt(sockfd_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &optval, sizeof optval);
+#endif
+}
+
+bool Socket::setReusePortCpuSteering(unsigned groupSize)
+{
+  // A = cpu; A %= groupSize; return A
+  struct sock_filter code[] = {
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, groupSize},
+      {BPF_RET | BPF_A, 0, 0, 0},
+  };
+  struct sock_fprog prog;
+  prog.len = sizeof code / sizeof code[0];
+  prog.filter = code;
+  if (::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0)
+  {
+    LOG_ERROR("SO_ATTACH_REUSEPORT_CBPF sockfd: %d fail, errno: %d \n", sockfd_, errno);
+    return false;
+  }
+  return true;
+}
@@ -25,6 +25,12 @@ public:
   void setReuseAddr(bool on);
   void setReusePort(bool on);
   void setKeepAlive(bool on);
+  // SO_BUSY_POLL，阻塞读或者epoll时在驱动队列上忙等microSeconds微秒；
+  // 同时设置SO_PREFER_BUSY_POLL(内核5.11+)，超过net.core.busy_read需要CAP_NET_ADMIN
+  void setBusyPoll(int microSeconds);
+  // 给这个socket所在的SO_REUSEPORT组挂一个CBPF程序，按处理数据包的CPU编号对groupSize取模
+  // 选择组里第几个socket(按listen的先后顺序)，需要在listen之后调用
+  bool setReusePortCpuSteering(unsigned groupSize);
 
 private:
   const int sockfd_;
@@ -0,0 +1,223 @@
+#include "StatsServer.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+  // 请求头超过这个长度还没结束就直接断开
+  const size_t kMaxRequestSize = 8192;
+
+  using LoopList = std::vector<std::pair<std::string, EventLoop *>>;
+
+  void appendf(std::string *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  // 直接格式化到out的末尾，一次放不下时按vsnprintf算出的长度扩大再格式化一遍，不会截断
+  void appendf(std::string *out, const char *fmt, ...)
+  {
+    const size_t kGuess = 256;
+    size_t old = out->size();
+    va_list args;
+    va_start(args, fmt);
+    va_list retry;
+    va_copy(retry, args);
+    out->resize(old + kGuess);
+    int n = vsnprintf(&(*out)[old], kGuess, fmt, args);
+    va_end(args);
+    if (n >= static_cast<int>(kGuess))
+    {
+      out->resize(old + n + 1);
+      vsnprintf(&(*out)[old], n + 1, fmt, retry);
+    }
+    va_end(retry);
+    out->resize(old + (n > 0 ? n : 0));
+  }
+
+  // 标签值里的反斜杠、引号和换行需要转义
+  std::string escapeLabel(const std::string &value)
+  {
+    std::string result;
+    result.reserve(value.size());
+    for (char c : value)
+    {
+      if (c == '\\' || c == '"')
+      {
+        result += '\\';
+        result += c;
+      }
+      else if (c == '\n')
+      {
+        result += "\\n";
+      }
+      else
+      {
+        result += c;
+      }
+    }
+    return result;
+  }
+
+  void appendHeader(std::string *out, const char *metric, const char *help, const char *type)
+  {
+    appendf(out, "# HELP %s %s\n# TYPE %s %s\n", metric, help, metric, type);
+  }
+
+  // 计数器和瞬时值，每个loop一行
+  void appendScalar(std::string *out, const LoopList &loops, const char *metric, const char *help,
+                    const char *type, double (*value)(const EventLoop *))
+  {
+    appendHeader(out, metric, help, type);
+    for (const auto &item : loops)
+    {
+      appendf(out, "%s{loop=\"%s\"} %.17g\n", metric, escapeLabel(item.first).c_str(), value(item.second));
+    }
+  }
+
+  // scale把桶的上界和sum换算成导出的单位，例如微秒换算成秒
+  void appendHistogram(std::string *out, const LoopList &loops, const char *metric, const char *help,
+                       const MetricHistogram &(*histogram)(const LoopMetrics &), double scale)
+  {
+    appendHeader(out, metric, help, "histogram");
+    for (const auto &item : loops)
+    {
+      std::string loop(escapeLabel(item.first));
+      MetricHistogram::Snapshot snap;
+      histogram(item.second->metrics()).snapshot(&snap);
+      uint64_t cumulative = 0;
+      // 最后一个桶没有上界，算在+Inf里
+      for (int i = 0; i < MetricHistogram::kBuckets - 1; ++i)
+      {
+        cumulative += snap.counts[i];
+        appendf(out, "%s_bucket{loop=\"%s\",le=\"%g\"} %lu\n", metric, loop.c_str(),
+                MetricHistogram::upperBound(i) * scale, (unsigned long)cumulative);
+      }
+      appendf(out, "%s_bucket{loop=\"%s\",le=\"+Inf\"} %lu\n", metric, loop.c_str(), (unsigned long)snap.count);
+      appendf(out, "%s_sum{loop=\"%s\"} %.17g\n", metric, loop.c_str(), snap.sum * scale);
+      appendf(out, "%s_count{loop=\"%s\"} %lu\n", metric, loop.c_str(), (unsigned long)snap.count);
+    }
+  }
+
+  void reply(const TcpConnectionPtr &conn, const char *status, const std::string &body)
+  {
+    std::string response;
+    appendf(&response, "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+            status, body.size());
+    response += body;
+    conn->send(std::move(response));
+    conn->shutdown();
+  }
+}
+
+StatsServer::StatsServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name)
+    : server_(new TcpServer(loop, listenAddr, name))
+{
+  server_->setConnectionCallback([](const TcpConnectionPtr &) {});
+  server_->setMessageCallback(std::bind(&StatsServer::onMessage, this, std::placeholders::_1,
+                                        std::placeholders::_2, std::placeholders::_3));
+}
+
+StatsServer::~StatsServer() = default;
+
+void StatsServer::addLoop(EventLoop *loop, const std::string &name)
+{
+  loops_.push_back(std::make_pair(name, loop));
+}
+
+void StatsServer::start()
+{
+  server_->start();
+}
+
+std::string StatsServer::render() const
+{
+  std::string out;
+  out.reserve(loops_.size() * 16 * 1024);
+  appendScalar(&out, loops_, "muduo_loop_iterations_total", "Event loop iterations.", "counter",
+               [](const EventLoop *loop)
+               { return static_cast<double>(loop->metrics().iterations.value()); });
+  appendScalar(&out, loops_, "muduo_loop_events_total", "Active channels returned by poll.", "counter",
+               [](const EventLoop *loop)
+               { return static_cast<double>(loop->metrics().events.value()); });
+  appendScalar(&out, loops_, "muduo_loop_functors_total", "Pending functors run.", "counter",
+               [](const EventLoop *loop)
+               { return static_cast<double>(loop->metrics().functors.value()); });
+  appendScalar(&out, loops_, "muduo_loop_read_bytes_total", "Bytes read by connections on the loop.", "counter",
+               [](const EventLoop *loop)
+               { return static_cast<double>(loop->metrics().bytesRead.value()); });
+  appendScalar(&out, loops_, "muduo_loop_written_bytes_total", "Bytes written by connections on the loop.", "counter",
+               [](const EventLoop *loop)
+               { return static_cast<double>(loop->metrics().bytesWritten.value()); });
+  appendScalar(&out, loops_, "muduo_loop_wakeups_total", "Writes to the wakeup eventfd.", "counter",
+               [](const EventLoop *loop)
+               { return static_cast<double>(loop->wakeupCount()); });
+  appendScalar(&out, loops_, "muduo_loop_connections", "Connections owned by the loop.", "gauge",
+               [](const EventLoop *loop)
+               { return static_cast<double>(loop->numConnections()); });
+  appendScalar(&out, loops_, "muduo_loop_queued_bytes", "Bytes waiting in output queues.", "gauge",
+               [](const EventLoop *loop)
+               { return static_cast<double>(loop->queuedBytes()); });
+  appendScalar(&out, loops_, "muduo_loop_busy_ratio", "Fraction of the last window spent handling events.", "gauge",
+               [](const EventLoop *loop)
+               { return loop->busyPermille() / 1000.0; });
+  appendScalar(&out, loops_, "muduo_loop_spin_ratio", "Fraction of the last window spent busy polling.", "gauge",
+               [](const EventLoop *loop)
+               { return loop->spinPermille() / 1000.0; });
+
+  appendHistogram(&out, loops_, "muduo_loop_events_per_poll", "Active channels per poll.",
+                  [](const LoopMetrics &m) -> const MetricHistogram &
+                  { return m.eventsPerPoll; },
+                  1);
+  appendHistogram(&out, loops_, "muduo_loop_functors_per_run", "Pending functors taken per run.",
+                  [](const LoopMetrics &m) -> const MetricHistogram &
+                  { return m.functorsPerRun; },
+                  1);
+  appendHistogram(&out, loops_, "muduo_loop_poll_seconds", "Time per iteration spent in poll, including waiting.",
+                  [](const LoopMetrics &m) -> const MetricHistogram &
+                  { return m.pollTime; },
+                  1e-6);
+  appendHistogram(&out, loops_, "muduo_loop_handler_seconds", "Time per iteration spent in channel handlers.",
+                  [](const LoopMetrics &m) -> const MetricHistogram &
+                  { return m.handlerTime; },
+                  1e-6);
+  appendHistogram(&out, loops_, "muduo_loop_functor_seconds", "Time per iteration spent in pending functors.",
+                  [](const LoopMetrics &m) -> const MetricHistogram &
+                  { return m.functorTime; },
+                  1e-6);
+  return out;
+}
+
+void StatsServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+  const char kEnd[] = "\r\n\r\n";
+  const char *end = std::search(buf->peek(), buf->peek() + buf->readableBytes(), kEnd, kEnd + 4);
+  if (end == buf->peek() + buf->readableBytes())
+  {
+    if (buf->readableBytes() > kMaxRequestSize)
+    {
+      buf->retrieveAll();
+      conn->shutdown();
+    }
+    return;
+  }
+  std::string request(buf->peek(), end);
+  buf->retrieveAll();
+
+  // 只看请求行，"GET /metrics HTTP/1.1"，允许带查询参数
+  std::string line(request, 0, request.find("\r\n"));
+  const char kGet[] = "GET /metrics";
+  if (line.compare(0, sizeof kGet - 1, kGet) == 0 &&
+      (line.size() == sizeof kGet - 1 || line[sizeof kGet - 1] == ' ' || line[sizeof kGet - 1] == '?'))
+  {
+    reply(conn, "200 OK", render());
+  }
+  else
+  {
+    LOG_DEBUG("StatsServer unknown request: %s \n", line.c_str());
+    reply(conn, "404 Not Found", "try GET /metrics\n");
+  }
+}
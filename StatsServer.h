@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+class EventLoop;
+class TcpServer;
+class Buffer;
+
+// 用Prometheus文本格式导出若干EventLoop的运行指标
+// 自带一个很小的HTTP服务，GET /metrics 返回render()的内容，每个请求之后关闭连接
+// 读取指标不经过被观察的loop，抓取时不会阻塞它们
+class StatsServer : noncopyable
+{
+public:
+  StatsServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name);
+  ~StatsServer();
+
+  // 需要在start之前调用，name作为指标的loop标签
+  void addLoop(EventLoop *loop, const std::string &name);
+  void start();
+
+  // 所有loop当前的指标，任意线程可以调用
+  std::string render() const;
+
+private:
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp);
+
+  std::unique_ptr<TcpServer> server_;
+  std::vector<std::pair<std::string, EventLoop *>> loops_;
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 只能移动的void()可调用对象，替代std::function作为EventLoop的任务类型
+// std::function的内联空间只有16字节，bind一个成员函数指针加shared_ptr就要分配内存，
+// 这里内联64字节，runInLoop/queueInLoop常见的bind(成员函数, shared_ptr, 参数)都放得下
+// 放不下或者移动可能抛异常的可调用对象才退化到堆上
+class Task
+{
+public:
+  static const size_t kInlineSize = 64;
+
+  // F能否不分配内存直接放进Task
+  template <typename F>
+  static constexpr bool fitsInline()
+  {
+    return sizeof(F) <= kInlineSize &&
+           alignof(F) <= alignof(Storage) &&
+           std::is_nothrow_move_constructible<F>::value;
+  }
+
+  Task() noexcept : ops_(nullptr) {}
+  Task(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+  Task(F &&f)
+      : ops_(nullptr)
+  {
+    init<typename std::decay<F>::type>(std::forward<F>(f),
+                                       std::integral_constant<bool, fitsInline<typename std::decay<F>::type>()>());
+  }
+
+  Task(Task &&other) noexcept
+      : ops_(other.ops_)
+  {
+    if (ops_)
+    {
+      ops_->move(&other.storage_, &storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  Task &operator=(Task &&other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      if (other.ops_)
+      {
+        other.ops_->move(&other.storage_, &storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  Task &operator=(std::nullptr_t) noexcept
+  {
+    reset();
+    return *this;
+  }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  ~Task() { reset(); }
+
+  void operator()() { ops_->invoke(&storage_); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  // 析构持有的可调用对象，捕获的shared_ptr等在这里释放
+  void reset() noexcept
+  {
+    if (ops_)
+    {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+private:
+  using Storage = typename std::aligned_storage<kInlineSize, alignof(void *)>::type;
+
+  // 手写的虚表，每种可调用对象类型一份
+  struct Ops
+  {
+    void (*invoke)(void *storage);
+    void (*move)(void *from, void *to);
+    void (*destroy)(void *storage);
+  };
+
+  template <typename F>
+  struct InlineOps
+  {
+    static void invoke(void *storage) { (*static_cast<F *>(storage))(); }
+    static void move(void *from, void *to)
+    {
+      F *src = static_cast<F *>(from);
+      new (to) F(std::move(*src));
+      src->~F();
+    }
+    static void destroy(void *storage) { static_cast<F *>(storage)->~F(); }
+    static const Ops ops;
+  };
+
+  template <typename F>
+  struct HeapOps
+  {
+    static void invoke(void *storage) { (**static_cast<F **>(storage))(); }
+    static void move(void *from, void *to) { *static_cast<F **>(to) = *static_cast<F **>(from); }
+    static void destroy(void *storage) { delete *static_cast<F **>(storage); }
+    static const Ops ops;
+  };
+
+  template <typename F, typename Arg>
+  void init(Arg &&f, std::true_type)
+  {
+    new (&storage_) F(std::forward<Arg>(f));
+    ops_ = &InlineOps<F>::ops;
+  }
+
+  template <typename F, typename Arg>
+  void init(Arg &&f, std::false_type)
+  {
+    *reinterpret_cast<F **>(&storage_) = new F(std::forward<Arg>(f));
+    ops_ = &HeapOps<F>::ops;
+  }
+
+  Storage storage_;
+  const Ops *ops_;
+};
+
+template <typename F>
+const Task::Ops Task::InlineOps<F>::ops = {&Task::InlineOps<F>::invoke, &Task::InlineOps<F>::move, &Task::InlineOps<F>::destroy};
+
+template <typename F>
+const Task::Ops Task::HeapOps<F>::ops = {&Task::HeapOps<F>::invoke, &Task::HeapOps<F>::move, &Task::HeapOps<F>::destroy};
@@ -0,0 +1,133 @@
+#include "TcpClient.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <stdio.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+static EventLoop *CheckLoopNotNull(EventLoop *loop)
+{
+  if (loop == nullptr)
+  {
+    LOG_FATAL("%s:%s:%d TcpClient Loop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+  }
+  return loop;
+}
+
+// TcpClient析构之后连接才断开时，把连接交给loop销毁
+static void removeConnectionAfterClient(EventLoop *loop, const TcpConnectionPtr &conn)
+{
+  loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+TcpClient::TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg)
+    : loop_(CheckLoopNotNull(loop)),
+      connector_(new Connector(loop, serverAddr)),
+      name_(nameArg),
+      connectionCallback_(),
+      messageCallback_(),
+      retry_(false),
+      connect_(true),
+      nextConnId_(1)
+{
+  connector_->setNewConnectionCallback(std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+  LOG_INFO("TcpClient::TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+}
+
+TcpClient::~TcpClient()
+{
+  LOG_INFO("TcpClient::~TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+  TcpConnectionPtr conn;
+  bool unique = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unique = connection_.unique();
+    conn = connection_;
+  }
+  if (conn)
+  {
+    // 连接的closeCallback还指向this，换成不依赖TcpClient的版本
+    EventLoop *loop = loop_;
+    loop_->runInLoop([conn, loop]()
+                     { conn->setCloseCallback(std::bind(&removeConnectionAfterClient, loop, std::placeholders::_1)); });
+    if (unique)
+    {
+      conn->forceClose();
+    }
+  }
+  else
+  {
+    connector_->stop();
+  }
+}
+
+void TcpClient::connect()
+{
+  LOG_INFO("TcpClient::connect[%s] - connecting to %s \n", name_.c_str(),
+           connector_->serverAddress().toIpPort().c_str());
+  connect_ = true;
+  connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+  connect_ = false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (connection_)
+  {
+    connection_->shutdown();
+  }
+}
+
+void TcpClient::stop()
+{
+  connect_ = false;
+  connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+  sockaddr_in peer;
+  sockaddr_in local;
+  socklen_t addrlen = sizeof peer;
+  ::bzero(&peer, sizeof peer);
+  ::bzero(&local, sizeof local);
+  ::getpeername(sockfd, (sockaddr *)&peer, &addrlen);
+  addrlen = sizeof local;
+  ::getsockname(sockfd, (sockaddr *)&local, &addrlen);
+  InetAddress peerAddr(peer);
+  InetAddress localAddr(local);
+
+  char buf[64];
+  snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+  ++nextConnId_;
+  std::string connName = name_ + buf;
+
+  TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr));
+  conn->setConnectionCallback(connectionCallback_);
+  conn->setMessageCallback(messageCallback_);
+  conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connection_ = conn;
+  }
+  conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connection_.reset();
+  }
+  loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+  if (retry_ && connect_)
+  {
+    LOG_INFO("TcpClient::connect[%s] - reconnecting to %s \n", name_.c_str(),
+             connector_->serverAddress().toIpPort().c_str());
+    connector_->restart();
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "TcpConnection.h"
+
+class Connector;
+class EventLoop;
+
+// 到一个服务端的单个连接，用Connector建立，建立之后和服务端的连接一样是TcpConnection
+class TcpClient : noncopyable
+{
+public:
+  TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg);
+  ~TcpClient();
+
+  // 以下三个都可以在任意线程调用
+  void connect();
+  // 关闭写端，等对端关闭
+  void disconnect();
+  // 停止连接中的Connector和重试
+  void stop();
+
+  TcpConnectionPtr connection() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connection_;
+  }
+
+  EventLoop *getLoop() const { return loop_; }
+  const std::string &name() const { return name_; }
+
+  // 连接断开后自动重连
+  void enableRetry() { retry_ = true; }
+  bool retry() const { return retry_; }
+
+  // 需要在connect之前设置
+  void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+  void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+  void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+private:
+  // 在loop线程里调用
+  void newConnection(int sockfd);
+  void removeConnection(const TcpConnectionPtr &conn);
+
+  EventLoop *loop_;
+  std::shared_ptr<Connector> connector_;
+  const std::string name_;
+  ConnectionCallback connectionCallback_;
+  MessageCallback messageCallback_;
+  WriteCompleteCallback writeCompleteCallback_;
+  std::atomic_bool retry_;
+  std::atomic_bool connect_;
+  // 只在loop线程里访问
+  int nextConnId_;
+  mutable std::mutex mutex_;
+  TcpConnectionPtr connection_;
+};
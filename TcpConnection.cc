@@ -3,9 +3,11 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "Tracer.h"
 
 #include <functional>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <strings.h>
@@ -35,7 +37,12 @@ TcpConnection::TcpConnection(
                                    channel_(new Channel(loop, sockfd)),
                                    localAddr_(localAddr),
                                    peerAddr_(peerAddr),
-                                   highWaterMark_(64 * 1024 * 1024)
+                                   highWaterMark_(64 * 1024 * 1024),
+                                   idleTimeout_(0),
+                                   inputBuffer_(loop_->bufferPool()),
+                                   outputBuffer_(loop_->bufferPool()),
+                                   reportedQueuedBytes_(0),
+                                   traceMark_(0)
 {
   channel_->setReadCallback(
       std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
@@ -49,6 +56,8 @@ TcpConnection::TcpConnection(
       std::bind(&TcpConnection::handleError, this));
   LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
   socket_->setKeepAlive(true);
+  idleEntry_.setCallback(&TcpConnection::onIdleTimeout, this);
+  loop_->connectionAdded();
 }
 
 TcpConnection::~TcpConnection()
@@ -59,42 +68,411 @@ TcpConnection::~TcpConnection()
 
 void TcpConnection::send(const std::string &buf)
 {
+  send(buf.data(), buf.size());
+}
+
+void TcpConnection::send(const void *data, size_t len)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendInLoop(data, len);
+    }
+    else
+    {
+      // 跨线程时调用者的内存随时会失效，拷贝一份交给loop线程
+      loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(),
+                                 std::string(static_cast<const char *>(data), len)));
+    }
+  }
+}
+
+void TcpConnection::send(std::string &&buf)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendStringInLoop(buf);
+    }
+    else
+    {
+      loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(buf)));
+    }
+  }
+}
+
+void TcpConnection::send(const std::shared_ptr<const std::string> &buf)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendSharedInLoop(buf);
+    }
+    else
+    {
+      loop_->runInLoop(std::bind(&TcpConnection::sendSharedInLoop, shared_from_this(), buf));
+    }
+  }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+  if (state_ == kConnected)
+  {
+    int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupfd < 0)
+    {
+      LOG_ERROR("TcpConnection::sendFile dup fd=%d err:%d", fd, errno);
+      return;
+    }
+    loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), dupfd, offset, length));
+  }
+}
+
+ssize_t TcpConnection::writeDirectly(const void *data, size_t len)
+{
+  ssize_t nwrote = 0;
+  // 没有排队的数据时才能直接写，否则会乱序
+  if (!channel_->isWriting() && outputBuffer_.empty() && len > 0)
+  {
+    nwrote = ::write(channel_->fd(), data, len);
+    if (nwrote >= 0)
+    {
+      loop_->metrics().bytesWritten.add(nwrote);
+      refreshIdleTimeout();
+      if (static_cast<size_t>(nwrote) == len && writeCompleteCallback_)
+      {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+      }
+    }
+    else
+    {
+      nwrote = 0;
+      if (errno != EWOULDBLOCK)
+      {
+        LOG_ERROR("TcpConnection::sendInLoop");
+        if (errno == EPIPE || errno == ECONNRESET)
+        {
+          return -1;
+        }
+      }
+    }
+  }
+  return nwrote;
+}
+
+void TcpConnection::afterQueued(size_t oldLen)
+{
+  // 高水位只统计占用内存的数据，文件区域不算
+  size_t newLen = outputBuffer_.bufferedBytes();
+  if (oldLen < highWaterMark_ && newLen >= highWaterMark_ && highWaterMarkCallback_)
+  {
+    loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+  }
+  updateQueuedBytes();
+  // 关注写事件，socket可写时由handleWrite继续发送
+  if (!channel_->isWriting())
+  {
+    channel_->enableWriting();
+  }
+}
+
+void TcpConnection::updateQueuedBytes()
+{
+  size_t queued = outputBuffer_.readableBytes();
+  if (queued != reportedQueuedBytes_)
+  {
+    loop_->addQueuedBytes(static_cast<int64_t>(queued) - static_cast<int64_t>(reportedQueuedBytes_));
+    reportedQueuedBytes_ = queued;
+  }
 }
 
 void TcpConnection::sendInLoop(const void *data, size_t len)
 {
+  if (state_ == kDisconnected)
+  {
+    LOG_ERROR("disconnected, give up writing!");
+    return;
+  }
+  ssize_t nwrote = writeDirectly(data, len);
+  if (nwrote < 0)
+  {
+    return;
+  }
+  size_t remaining = len - nwrote;
+  if (remaining > 0)
+  {
+    size_t oldLen = outputBuffer_.bufferedBytes();
+    outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
+    afterQueued(oldLen);
+  }
+}
+
+void TcpConnection::sendStringInLoop(std::string &buf)
+{
+  if (state_ == kDisconnected)
+  {
+    LOG_ERROR("disconnected, give up writing!");
+    return;
+  }
+  ssize_t nwrote = writeDirectly(buf.data(), buf.size());
+  if (nwrote < 0)
+  {
+    return;
+  }
+  if (static_cast<size_t>(nwrote) < buf.size())
+  {
+    size_t oldLen = outputBuffer_.bufferedBytes();
+    // 剩下的部分连同字符串一起放进输出队列，不拷贝
+    outputBuffer_.append(std::move(buf), nwrote);
+    afterQueued(oldLen);
+  }
+}
+
+void TcpConnection::sendSharedInLoop(const std::shared_ptr<const std::string> &buf)
+{
+  if (state_ == kDisconnected)
+  {
+    LOG_ERROR("disconnected, give up writing!");
+    return;
+  }
+  ssize_t nwrote = writeDirectly(buf->data(), buf->size());
+  if (nwrote < 0)
+  {
+    return;
+  }
+  if (static_cast<size_t>(nwrote) < buf->size())
+  {
+    size_t oldLen = outputBuffer_.bufferedBytes();
+    outputBuffer_.append(buf, buf->data() + nwrote, buf->size() - nwrote);
+    afterQueued(oldLen);
+  }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length)
+{
+  if (state_ == kDisconnected)
+  {
+    LOG_ERROR("disconnected, give up writing!");
+    ::close(fd);
+    return;
+  }
+  size_t oldLen = outputBuffer_.bufferedBytes();
+  bool idle = !channel_->isWriting() && outputBuffer_.empty();
+  outputBuffer_.appendFile(fd, offset, length);
+  if (idle)
+  {
+    // 前面没有排队的数据，不等可写事件，直接发送一次
+    int savedErrno = 0;
+    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+    if (n > 0)
+    {
+      loop_->metrics().bytesWritten.add(n);
+      refreshIdleTimeout();
+    }
+    if (outputBuffer_.empty())
+    {
+      updateQueuedBytes();
+      if (writeCompleteCallback_)
+      {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+      }
+      return;
+    }
+  }
+  afterQueued(oldLen);
 }
 
 void TcpConnection::shutdown()
 {
+  if (state_ == kConnected)
+  {
+    setState(kDisconnecting);
+    loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+  }
 }
 
 void TcpConnection::shutdownInLoop()
 {
+  // 输出队列里还有数据时，等handleWrite发送完再关闭写端
+  if (!channel_->isWriting())
+  {
+    socket_->shutdownWrite();
+  }
+}
+
+void TcpConnection::forceClose()
+{
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    setState(kDisconnecting);
+    loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+  }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+  // 和对端断开一样走handleClose
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    handleClose();
+  }
+}
+
+void TcpConnection::setEdgeTriggered(bool on)
+{
+  channel_->setEdgeTriggered(on);
+}
+
+void TcpConnection::setSocketBusyPoll(int microSeconds)
+{
+  socket_->setBusyPoll(microSeconds);
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+  socket_->setTcpNoDelay(on);
 }
 
 void TcpConnection::connectEstablished()
 {
+  setState(kConnected);
+  channel_->tie(shared_from_this());
+  channel_->enableReading();
+  refreshIdleTimeout();
+
+  connectionCallback_(shared_from_this());
 }
 
 void TcpConnection::connectDestroyed()
 {
+  if (idleEntry_.armed())
+  {
+    loop_->timingWheel()->cancel(&idleEntry_);
+  }
+  // kDisconnecting: shutdown或forceClose还没走到handleClose，这里直接收尾，
+  // 之后排队的forceCloseInLoop看到kDisconnected就不会再碰已经remove的channel
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    setState(kDisconnected);
+    channel_->disableAll();
+    connectionCallback_(shared_from_this());
+  }
+  channel_->remove();
+  // loop上的计数都在loop线程里撤销，析构函数可能在任意线程、loop析构之后才执行
+  loop_->connectionRemoved();
+  // 没发完的数据不再算在loop头上
+  if (reportedQueuedBytes_ > 0)
+  {
+    loop_->addQueuedBytes(-static_cast<int64_t>(reportedQueuedBytes_));
+    reportedQueuedBytes_ = 0;
+  }
+  // 缓冲区的内存来自loop的BufferPool，在loop线程里还回去；
+  // 最后一个TcpConnectionPtr可能在别的线程、甚至loop析构之后才释放，析构函数里不能再碰pool
+  inputBuffer_.retrieveAll();
+  inputBuffer_.releaseIfEmpty();
+  outputBuffer_.retrieveAll();
+}
+
+void TcpConnection::refreshIdleTimeout()
+{
+  if (idleTimeout_ > 0)
+  {
+    loop_->timingWheel()->refresh(&idleEntry_, idleTimeout_);
+  }
+}
+
+void TcpConnection::onIdleTimeout(void *arg)
+{
+  TcpConnection *conn = static_cast<TcpConnection *>(arg);
+  LOG_INFO("TcpConnection::onIdleTimeout [%s] idle for %d seconds\n", conn->name_.c_str(), conn->idleTimeout_);
+  // 和对端断开一样走handleClose，由TcpServer统一回收
+  if (conn->state_ == kConnected || conn->state_ == kDisconnecting)
+  {
+    conn->handleClose();
+  }
+}
+
+void TcpConnection::traceName()
+{
+  if (Tracer::enabled())
+  {
+    Tracer::nameFd(channel_->fd(), name_, &traceMark_);
+  }
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+  traceName();
+  int savedErrno = 0;
+  bool eof = false;
+  ssize_t n;
+  if (channel_->edgeTriggered())
+  {
+    // 边沿触发必须读到EAGAIN，否则剩下的数据不会再通知
+    n = inputBuffer_.readfdUntilEagain(channel_->fd(), &savedErrno, &eof);
+  }
+  else
+  {
+    n = inputBuffer_.readfd(channel_->fd(), &savedErrno);
+  }
+  if (n > 0)
+  {
+    loop_->metrics().bytesRead.add(n);
+    refreshIdleTimeout();
+    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    // 数据都被取走了就把内存还给pool，空闲连接不占用缓冲区
+    inputBuffer_.releaseIfEmpty();
+    if (eof && state_ != kDisconnected)
+    {
+      handleClose();
+    }
+  }
+  else if (n == 0)
+  {
+    // 边沿触发下返回0也可能是第一次read就EAGAIN(数据已经被上一次读完)，只有eof才是对端关闭
+    if (!channel_->edgeTriggered() || eof)
+    {
+      handleClose();
+    }
+  }
+  else
+  {
+    errno = savedErrno;
+    LOG_ERROR("TcpConnection::handleRead");
+    handleError();
+  }
 }
 
 void TcpConnection::handleWrite()
 {
+  traceName();
   if (channel_->isWriting())
   {
     int savedErrno = 0;
-    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-    if (n > 0)
+    ssize_t total = 0;
+    ssize_t n;
+    do
+    {
+      n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+      if (n > 0)
+      {
+        total += n;
+      }
+      // 边沿触发必须写到EAGAIN或者写完，否则不会再有可写通知
+    } while (channel_->edgeTriggered() && n > 0 && !outputBuffer_.empty());
+    if (total > 0)
+    {
+      loop_->metrics().bytesWritten.add(total);
+      refreshIdleTimeout();
+      updateQueuedBytes();
+    }
+    if (n >= 0 || savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
     {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0)
+      if (outputBuffer_.empty())
       {
         channel_->disableWriting();
         if (writeCompleteCallback_)
@@ -117,6 +495,7 @@ void TcpConnection::handleWrite()
 
 void TcpConnection::handleClose()
 {
+  traceName();
   LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
   setState(kDisconnected);
   channel_->disableAll();
@@ -128,6 +507,7 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+  traceName();
   int optval;
   socklen_t optlen = sizeof optval;
   int err = 0;
@@ -4,7 +4,9 @@
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "OutputQueue.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
 
 #include <memory>
 #include <string>
@@ -29,12 +31,24 @@ public:
   const InetAddress &localAddress() const { return localAddr_; }
   const InetAddress &peerAddress() const { return peerAddr_; }
 
-  bool connected() const { return state_ == KConnected; }
+  bool connected() const { return state_ == kConnected; }
 
-  // 发送数据
+  // 发送数据，线程安全
+  // 拷贝一份数据
   void send(const std::string &buf);
+  void send(const void *data, size_t len);
+  // 接管字符串，不拷贝
+  void send(std::string &&buf);
+  // 共享只读数据(比如缓存的响应)，不拷贝，发送完成后释放引用
+  void send(const std::shared_ptr<const std::string> &buf);
+  // 用sendfile发送文件fd中[offset, offset+length)的内容，和前后send的数据保持顺序
+  // 内部会dup一份fd，调用之后可以立即关闭fd
+  // 全部发送完成后触发writeCompleteCallback
+  void sendFile(int fd, off_t offset, size_t length);
   // 关闭连接
   void shutdown();
+  // 不等输出队列发完，直接关闭连接，线程安全
+  void forceClose();
 
   void setConnectionCallback(const ConnectionCallback &cb)
   {
@@ -62,6 +76,18 @@ public:
     closeCallback_ = cb;
   }
 
+  // 空闲超时(秒)，超过这么久没有读写就关闭连接，0表示不启用
+  // 需要在connectEstablished之前设置
+  void setIdleTimeout(int seconds) { idleTimeout_ = seconds; }
+
+  // 在socket上设置SO_BUSY_POLL/SO_PREFER_BUSY_POLL，见Socket::setBusyPoll
+  void setSocketBusyPoll(int microSeconds);
+  // 关闭Nagle算法，小消息立即发出
+  void setTcpNoDelay(bool on);
+
+  // 边沿触发(EPOLLET)，读写都做到EAGAIN，需要在connectEstablished之前设置
+  void setEdgeTriggered(bool on);
+
   // 连接建立
   void connectEstablished();
   // 连接销毁
@@ -83,7 +109,24 @@ private:
   void handleError();
 
   void sendInLoop(const void *message, size_t len);
+  void sendStringInLoop(std::string &buf);
+  void sendSharedInLoop(const std::shared_ptr<const std::string> &buf);
+  void sendFileInLoop(int fd, off_t offset, size_t length);
+  // 输出队列为空时先尝试直接写socket，返回写出去的字节数，出错时返回-1
+  ssize_t writeDirectly(const void *data, size_t len);
+  // 数据进入输出队列之后，检查高水位并关注写事件
+  void afterQueued(size_t oldLen);
+  // 把输出队列长度的变化同步到loop的负载统计
+  void updateQueuedBytes();
   void shutdownInLoop();
+  void forceCloseInLoop();
+
+  // 有读写活动时推迟空闲超时，不分配内存
+  void refreshIdleTimeout();
+  // 时间轮到期回调
+  static void onIdleTimeout(void *arg);
+  // 打开Tracer时把fd和连接名对应起来，见Tracer::nameFd
+  void traceName();
 
   EventLoop *loop_; // 注意这个不是baseloop
 
@@ -104,6 +147,12 @@ private:
   CloseCallback closeCallback_;
   size_t highWaterMark_;
 
+  int idleTimeout_;
+  TimingWheel::Entry idleEntry_;
+
   Buffer inputBuffer_;
-  Buffer outputBuffer_;
+  OutputQueue outputBuffer_;
+  // 已经计入loop_->queuedBytes()的字节数
+  size_t reportedQueuedBytes_;
+  uint64_t traceMark_;
 };
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include "TcpServer.h"
 #include "Logger.h"
 #include "TcpConnection.h"
+#include "StatsServer.h"
 
 #include <strings.h>
 #include <functional>
+#include <future>
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -21,19 +23,44 @@ TcpServer::TcpServer(EventLoop *loop,
     : loop_(CheckLoopNotNull(loop)),
       ipPort_(listenAddr.toIpPort()),
       name_(nameArg),
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      listenAddr_(listenAddr),
+      reusePortPerLoop_(option == kReusePortPerLoop),
+      // 每个loop一个监听socket时，acceptor在start里按loop创建
+      acceptor_(reusePortPerLoop_ ? nullptr : new Acceptor(loop, listenAddr, option == kReusePort)),
       threadPool_(new EventLoopThreadPool(loop, name_)),
       connectionCallback_(),
       messageCallback_(),
+      started_(0),
       nextConnId_(1),
-      started_(0)
+      idleTimeout_(0),
+      edgeTriggered_(false),
+      cpuSteering_(false),
+      maxAcceptsPerWakeup_(0),
+      busyPollMicroSeconds_(0),
+      socketBusyPoll_(false)
 {
-  acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection,
-                                                this, std::placeholders::_1, std::placeholders::_2));
+  if (acceptor_)
+  {
+    acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection,
+                                                  this, std::placeholders::_1, std::placeholders::_2));
+  }
 }
 
 TcpServer::~TcpServer()
 {
+  // 各个loop的acceptor和连接只能在自己的loop线程里销毁，等销毁完再继续，
+  // 之后这些loop上不会再回调到TcpServer
+  for (auto &item : loopAcceptors_)
+  {
+    LoopAcceptor *acceptor = item.get();
+    std::promise<void> done;
+    acceptor->loop->runInLoop([acceptor, &done]()
+                              {
+      destroyLoopAcceptor(acceptor);
+      done.set_value(); });
+    done.get_future().wait();
+  }
+
   for (auto &item : connections_)
   {
     TcpConnectionPtr conn(item.second);
@@ -44,14 +71,134 @@ TcpServer::~TcpServer()
   }
 }
 
+void TcpServer::setThreadNum(int numThreads)
+{
+  threadPool_->setThreadNum(numThreads);
+}
+
+void TcpServer::start()
+{
+  // 防止一个TcpServer被start多次
+  if (started_++ == 0)
+  {
+    threadPool_->start(threadInitCallback_);
+    if (busyPollMicroSeconds_ > 0)
+    {
+      for (EventLoop *ioLoop : threadPool_->getAllLoops())
+      {
+        int microSeconds = busyPollMicroSeconds_;
+        ioLoop->runInLoop([ioLoop, microSeconds]()
+                          { ioLoop->setBusyPoll(microSeconds); });
+      }
+    }
+    if (statsAddr_)
+    {
+      stats_.reset(new StatsServer(loop_, *statsAddr_, name_ + "-stats"));
+      std::vector<EventLoop *> loops(threadPool_->getAllLoops());
+      for (size_t i = 0; i < loops.size(); ++i)
+      {
+        stats_->addLoop(loops[i], name_ + "-" + std::to_string(i));
+      }
+      stats_->start();
+    }
+    if (reusePortPerLoop_)
+    {
+      startLoopAcceptors();
+    }
+    else
+    {
+      if (maxAcceptsPerWakeup_ > 0)
+      {
+        acceptor_->setMaxAcceptsPerWakeup(maxAcceptsPerWakeup_);
+      }
+      loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+    }
+  }
+}
+
+void TcpServer::startLoopAcceptors()
+{
+  std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    LoopAcceptor *acceptor = new LoopAcceptor;
+    acceptor->loop = loops[i];
+    acceptor->index = static_cast<int>(i);
+    acceptor->nextConnId = 1;
+    acceptor->acceptor.reset(new Acceptor(loops[i], listenAddr_, true));
+    acceptor->acceptor->setNewConnectionCallback(std::bind(&TcpServer::newLoopConnection,
+                                                           this, acceptor, std::placeholders::_1, std::placeholders::_2));
+    if (maxAcceptsPerWakeup_ > 0)
+    {
+      acceptor->acceptor->setMaxAcceptsPerWakeup(maxAcceptsPerWakeup_);
+    }
+    loopAcceptors_.push_back(std::unique_ptr<LoopAcceptor>(acceptor));
+
+    // 逐个同步listen，reuseport组里socket的顺序就是loop的顺序，CPU分流依赖这一点
+    std::promise<void> listened;
+    acceptor->loop->runInLoop([acceptor, &listened]()
+                              {
+      acceptor->acceptor->listen();
+      listened.set_value(); });
+    listened.get_future().wait();
+  }
+
+  // 程序挂在组上，对组里所有socket生效
+  if (cpuSteering_ && !loopAcceptors_.empty())
+  {
+    loopAcceptors_.front()->acceptor->setCpuSteering(static_cast<unsigned>(loopAcceptors_.size()));
+  }
+}
+
+uint64_t TcpServer::acceptWakeups() const
+{
+  uint64_t n = acceptor_ ? acceptor_->wakeups() : 0;
+  for (const auto &item : loopAcceptors_)
+  {
+    n += item->acceptor->wakeups();
+  }
+  return n;
+}
+
+uint64_t TcpServer::acceptedConnections() const
+{
+  uint64_t n = acceptor_ ? acceptor_->accepted() : 0;
+  for (const auto &item : loopAcceptors_)
+  {
+    n += item->acceptor->accepted();
+  }
+  return n;
+}
+
+uint64_t TcpServer::droppedConnections() const
+{
+  uint64_t n = acceptor_ ? acceptor_->dropped() : 0;
+  for (const auto &item : loopAcceptors_)
+  {
+    n += item->acceptor->dropped();
+  }
+  return n;
+}
+
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
-  EventLoop *ioLoop = threadPool_->getNextLoop();
+  EventLoop *ioLoop = threadPool_->getLoopForConnection(peerAddr);
   char buf[64] = {0};
-  snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId);
+  snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
   ++nextConnId_;
   std::string connName = name_ + buf;
 
+  TcpConnectionPtr conn = createConnection(ioLoop, connName, sockfd, peerAddr);
+  connections_[connName] = conn;
+  conn->setCloseCallback(
+      std::bind(&TcpServer ::removeConnection, this, std::placeholders::_1));
+
+  ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop *ioLoop, const std::string &connName,
+                                             int sockfd, const InetAddress &peerAddr)
+{
   LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
            name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
 
@@ -71,16 +218,52 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
       localAddr,
       peerAddr));
 
-  connections_[connName] = conn;
-
   conn->setConnectionCallback(connectionCallback_);
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setIdleTimeout(idleTimeout_);
+  conn->setEdgeTriggered(edgeTriggered_);
+  if (socketBusyPoll_ && busyPollMicroSeconds_ > 0)
+  {
+    conn->setSocketBusyPoll(busyPollMicroSeconds_);
+  }
+  return conn;
+}
+
+// 在acceptor所在的loop线程里调用
+void TcpServer::newLoopConnection(LoopAcceptor *acceptor, int sockfd, const InetAddress &peerAddr)
+{
+  char buf[64] = {0};
+  snprintf(buf, sizeof buf, "-%s#%d-%d", ipPort_.c_str(), acceptor->index, acceptor->nextConnId);
+  ++acceptor->nextConnId;
+  std::string connName = name_ + buf;
 
+  TcpConnectionPtr conn = createConnection(acceptor->loop, connName, sockfd, peerAddr);
+  acceptor->connections[connName] = conn;
   conn->setCloseCallback(
-      std::bind(&TcpServer ::removeConnection, this, std::placeholders::_1));
+      std::bind(&TcpServer::removeLoopConnection, this, acceptor, std::placeholders::_1));
 
-  ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+  conn->connectEstablished();
+}
+
+// 连接关闭时在它自己的loop线程里调用
+void TcpServer::removeLoopConnection(LoopAcceptor *acceptor, const TcpConnectionPtr &conn)
+{
+  LOG_INFO("TcpServer::removeLoopConnection [%s] - connection %s\n",
+           name_.c_str(), conn->name().c_str());
+  acceptor->connections.erase(conn->name());
+  acceptor->loop->queueInLoop(
+      std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+void TcpServer::destroyLoopAcceptor(LoopAcceptor *acceptor)
+{
+  acceptor->acceptor.reset();
+  for (auto &item : acceptor->connections)
+  {
+    item.second->connectDestroyed();
+  }
+  acceptor->connections.clear();
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
@@ -96,5 +279,5 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
   connections_.erase(conn->name());
   EventLoop *ioLoop = conn->getLoop();
   ioLoop->queueInLoop(
-      std::bind(&TcpConnection::connectDestoryed, conn));
+      std::bind(&TcpConnection::connectDestroyed, conn));
 }
\ No newline at end of file
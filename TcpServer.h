@@ -4,6 +4,7 @@
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
 
 #include "EventLoop.h"
 #include "Acceptor.h"
@@ -14,6 +15,8 @@
 #include "TcpConnection.h"
 #include "Buffer.h"
 
+class StatsServer;
+
 class TcpServer : noncopyable
 {
 public:
@@ -22,6 +25,9 @@ public:
   {
     kNoReusePort,
     kReusePort,
+    // 每个ioLoop各自创建一个SO_REUSEPORT的监听socket，由内核把新连接分到各个loop，
+    // 连接直接在accept它的loop上建立和回收，不经过baseLoop
+    kReusePortPerLoop,
   };
 
   TcpServer(EventLoop *loop,
@@ -49,8 +55,54 @@ public:
     writeCompleteCallback_ = cb;
   }
 
+  // 连接空闲超时(秒)，由每个ioLoop上的时间轮管理，0表示不启用
+  void setIdleTimeout(int seconds) { idleTimeout_ = seconds; }
+
+  // 新连接使用边沿触发(EPOLLET)，默认水平触发
+  void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+  // kReusePortPerLoop模式下按处理数据包的CPU选择监听socket，第i个ioLoop对应CPU i，
+  // 配合ioLoop线程绑核使用，需要在start之前设置
+  void setCpuSteering(bool on) { cpuSteering_ = on; }
+
+  // 每次监听socket可读时最多accept的连接数，见Acceptor，需要在start之前设置
+  void setMaxAcceptsPerWakeup(int n) { maxAcceptsPerWakeup_ = n; }
+
+  // 所有acceptor的统计之和，start之后可以在任意线程调用
+  uint64_t acceptWakeups() const;
+  uint64_t acceptedConnections() const;
+  uint64_t droppedConnections() const;
+
   void setThreadNum(int numThreads);
 
+  // ioLoop忙轮询，见EventLoop::setBusyPoll，socketBusyPoll为true时
+  // 连接的socket同时设置SO_BUSY_POLL，需要在start之前设置
+  void setBusyPoll(int microSeconds, bool socketBusyPoll = false)
+  {
+    busyPollMicroSeconds_ = microSeconds;
+    socketBusyPoll_ = socketBusyPoll;
+  }
+
+  // ioLoop线程绑核，见EventLoopThreadPool::setThreadAffinity，需要在start之前设置
+  // 可以用CpuAffinity::availableCpus()作为参数，每个loop一个核
+  void setThreadAffinity(const std::vector<int> &cpus) { threadPool_->setThreadAffinity(cpus); }
+
+  // 新连接分配到ioLoop的策略，默认轮询，需要在start之前设置
+  // kReusePortPerLoop模式下连接由内核分配，不使用这个策略
+  void setPlacement(EventLoopThreadPool::Placement placement,
+                    EventLoopThreadPool::LoadSignal signal = EventLoopThreadPool::kActiveConnections)
+  {
+    threadPool_->setPlacement(placement, signal);
+  }
+
+  // start时在baseLoop上另外监听statsAddr，GET /metrics 返回所有ioLoop的运行指标，
+  // 格式和指标见StatsServer，需要在start之前设置
+  void enableStats(const InetAddress &statsAddr)
+  {
+    statsAddr_.reset(new InetAddress(statsAddr));
+  }
+
+  // kReusePortPerLoop模式下会等每个ioLoop都开始listen再返回，需要在baseLoop线程里调用
   void start();
 
 private:
@@ -60,12 +112,32 @@ private:
 
   using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
 
+  // kReusePortPerLoop模式下每个ioLoop自己的acceptor和连接表，只在这个loop线程里访问
+  struct LoopAcceptor
+  {
+    EventLoop *loop;
+    int index;
+    int nextConnId;
+    std::unique_ptr<Acceptor> acceptor;
+    ConnectionMap connections;
+  };
+
+  TcpConnectionPtr createConnection(EventLoop *ioLoop, const std::string &connName,
+                                    int sockfd, const InetAddress &peerAddr);
+  void startLoopAcceptors();
+  void newLoopConnection(LoopAcceptor *acceptor, int sockfd, const InetAddress &peerAddr);
+  void removeLoopConnection(LoopAcceptor *acceptor, const TcpConnectionPtr &conn);
+  static void destroyLoopAcceptor(LoopAcceptor *acceptor);
+
   EventLoop *loop_;
 
   const std::string ipPort_;
   const std::string name_;
+  const InetAddress listenAddr_;
+  const bool reusePortPerLoop_;
 
   std::unique_ptr<Acceptor> acceptor_;
+  std::vector<std::unique_ptr<LoopAcceptor>> loopAcceptors_;
 
   std::shared_ptr<EventLoopThreadPool> threadPool_;
 
@@ -78,5 +150,14 @@ private:
   std::atomic_int started_;
 
   int nextConnId_;
+  int idleTimeout_;
+  bool edgeTriggered_;
+  bool cpuSteering_;
+  int maxAcceptsPerWakeup_;
+  int busyPollMicroSeconds_;
+  bool socketBusyPoll_;
   ConnectionMap connections_;
+
+  std::unique_ptr<InetAddress> statsAddr_;
+  std::unique_ptr<StatsServer> stats_;
 };
\ No newline at end of file
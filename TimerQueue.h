@@ -0,0 +1,56 @@
+#pragma once
+
+#include <set>
+#include <vector>
+#include <memory>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+// 基于timerfd的定时器队列，timerfd作为一个普通channel注册到所属loop的poller上
+// 所有的增删都在loop线程内完成，跨线程调用通过runInLoop转发
+class TimerQueue : noncopyable
+{
+public:
+  explicit TimerQueue(EventLoop *loop);
+  ~TimerQueue();
+
+  // 线程安全，可以在任意线程调用
+  TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+  void cancel(TimerId timerId);
+
+private:
+  // 按到期时间排序，地址用来区分同一时刻到期的定时器
+  using Entry = std::pair<Timestamp, Timer *>;
+  using TimerList = std::set<Entry>;
+  // 按地址+序号索引，供cancel使用
+  using ActiveTimer = std::pair<Timer *, int64_t>;
+  using ActiveTimerSet = std::set<ActiveTimer>;
+
+  void addTimerInLoop(Timer *timer);
+  void cancelInLoop(TimerId timerId);
+  // timerfd可读时调用
+  void handleRead();
+  // 取出所有到期的定时器
+  std::vector<Entry> getExpired(Timestamp now);
+  // 重复定时器重新插入，一次性定时器释放
+  void reset(const std::vector<Entry> &expired, Timestamp now);
+  // 返回最早到期时间是否发生了变化
+  bool insert(Timer *timer);
+
+  EventLoop *loop_;
+  const int timerfd_;
+  Channel timerfdChannel_;
+  TimerList timers_;
+
+  ActiveTimerSet activeTimers_;
+  bool callingExpiredTimers_;
+  // 在回调里被cancel掉的定时器，reset时不能再插回去
+  ActiveTimerSet cancelingTimers_;
+};
@@ -1,8 +1,10 @@
 #include <time.h>
+#include <sys/time.h>
 
 #include "Timestamp.h"
 
 Timestamp::Timestamp()
+    : microSecondsSinceEpoch_(0)
 {
 }
 
@@ -13,18 +15,23 @@ Timestamp::Timestamp(int64_t microSeconds)
 
 Timestamp Timestamp::now()
 {
-  time_t t = time(NULL);
-  return Timestamp(t);
+  // 定时器需要微秒精度
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  int64_t seconds = tv.tv_sec;
+  return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const
 {
   char buf[128] = {0};
-  tm *tm_time = localtime(&microSecondsSinceEpoch_);
+  time_t seconds = secondsSinceEpoch();
+  tm tm_time;
+  localtime_r(&seconds, &tm_time);
   // 得到格式化输出
   snprintf(buf, 128, "%4d-%02d-%02d %02d:%02d:%02d",
-           tm_time->tm_year + 1900, tm_time->tm_mon + 1, tm_time->tm_mday,
-           tm_time->tm_hour, tm_time->tm_min, tm_time->tm_sec);
+           tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+           tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
   return buf;
 }
 
@@ -34,4 +41,4 @@ std::string Timestamp::toString() const
 //   Timestamp t;
 //   std::cout << t.now().toString();
 //   return 0;
-// }
\ No newline at end of file
+// }
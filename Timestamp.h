@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <string>
 
 class Timestamp
 {
@@ -8,8 +9,42 @@ public:
   Timestamp();
   explicit Timestamp(int64_t microSeconds);
   static Timestamp now();
+  static Timestamp invalid() { return Timestamp(); }
   std::string toString() const;
 
+  bool valid() const { return microSecondsSinceEpoch_ > 0; }
+  int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+  time_t secondsSinceEpoch() const
+  {
+    return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+  }
+
+  static const int kMicroSecondsPerSecond = 1000 * 1000;
+
 private:
   int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+  return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+  return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点的差值，单位秒
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+  int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+  return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 在timestamp的基础上加上seconds秒
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+  int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+  return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,209 @@
+#include "TimingWheel.h"
+
+void TimingWheel::Entry::unlink()
+{
+  if (next != nullptr)
+  {
+    prev->next = next;
+    next->prev = prev;
+    prev = next = nullptr;
+  }
+}
+
+void TimingWheel::initList(Node *head)
+{
+  head->prev = head->next = head;
+}
+
+void TimingWheel::listAppend(Node *head, Node *node)
+{
+  node->prev = head->prev;
+  node->next = head;
+  head->prev->next = node;
+  head->prev = node;
+}
+
+void TimingWheel::listSplice(Node *from, Node *to)
+{
+  if (listEmpty(from))
+  {
+    initList(to);
+    return;
+  }
+  to->next = from->next;
+  to->prev = from->prev;
+  to->next->prev = to;
+  to->prev->next = to;
+  initList(from);
+}
+
+TimingWheel::TimingWheel()
+    : current_(0),
+      size_(0)
+{
+  for (int i = 0; i < kRootSize; ++i)
+  {
+    initList(&root_[i]);
+  }
+  for (int level = 0; level < kNumLevels; ++level)
+  {
+    for (int i = 0; i < kLevelSize; ++i)
+    {
+      initList(&levels_[level][i]);
+    }
+  }
+}
+
+TimingWheel::~TimingWheel()
+{
+  // 摘掉所有节点，避免使用者析构Entry时访问已经释放的表头
+  for (int i = 0; i < kRootSize; ++i)
+  {
+    while (!listEmpty(&root_[i]))
+    {
+      static_cast<Entry *>(root_[i].next)->unlink();
+    }
+  }
+  for (int level = 0; level < kNumLevels; ++level)
+  {
+    for (int i = 0; i < kLevelSize; ++i)
+    {
+      while (!listEmpty(&levels_[level][i]))
+      {
+        static_cast<Entry *>(levels_[level][i].next)->unlink();
+      }
+    }
+  }
+}
+
+void TimingWheel::place(Entry *entry)
+{
+  uint64_t expires = entry->expire_;
+  uint64_t idx = expires - current_;
+  Node *head;
+  if (idx < kRootSize)
+  {
+    head = &root_[expires & kRootMask];
+  }
+  else
+  {
+    int level = 0;
+    while (level < kNumLevels - 1 && idx >= (1ULL << (kRootBits + (level + 1) * kLevelBits)))
+    {
+      ++level;
+    }
+    // 超出最大范围的按最大范围处理，到达后会根据deadline_重新挂载
+    if (idx >= (1ULL << (kRootBits + kNumLevels * kLevelBits)))
+    {
+      expires = current_ + (1ULL << (kRootBits + kNumLevels * kLevelBits)) - 1;
+      entry->expire_ = expires;
+    }
+    int shift = kRootBits + level * kLevelBits;
+    head = &levels_[level][(expires >> shift) & kLevelMask];
+  }
+  listAppend(head, entry);
+}
+
+void TimingWheel::add(Entry *entry, uint64_t ticks)
+{
+  if (ticks == 0)
+  {
+    ticks = 1;
+  }
+  if (entry->armed())
+  {
+    entry->unlink();
+  }
+  else
+  {
+    ++size_;
+  }
+  entry->wheel_ = this;
+  // 第ticks次调用tick()时到期
+  entry->deadline_ = current_ + ticks - 1;
+  entry->expire_ = entry->deadline_;
+  place(entry);
+}
+
+void TimingWheel::refresh(Entry *entry, uint64_t ticks)
+{
+  if (ticks == 0)
+  {
+    ticks = 1;
+  }
+  uint64_t deadline = current_ + ticks - 1;
+  if (entry->armed() && deadline >= entry->expire_)
+  {
+    // 热路径：只记录新的到期时间，一次写内存
+    entry->deadline_ = deadline;
+  }
+  else
+  {
+    add(entry, ticks);
+  }
+}
+
+void TimingWheel::cancel(Entry *entry)
+{
+  if (entry->armed())
+  {
+    entry->unlink();
+    --size_;
+  }
+}
+
+int TimingWheel::cascade(int level)
+{
+  int index = levelIndex(level);
+  Node list;
+  listSplice(&levels_[level][index], &list);
+  while (!listEmpty(&list))
+  {
+    Entry *entry = static_cast<Entry *>(list.next);
+    entry->unlink();
+    place(entry);
+  }
+  return index;
+}
+
+size_t TimingWheel::tick()
+{
+  int index = static_cast<int>(current_ & kRootMask);
+  // 根轮转完一圈时，从高层依次往下搬运
+  if (index == 0)
+  {
+    for (int level = 0; level < kNumLevels; ++level)
+    {
+      if (cascade(level) != 0)
+      {
+        break;
+      }
+    }
+  }
+  ++current_;
+
+  Node expired;
+  listSplice(&root_[index], &expired);
+
+  size_t count = 0;
+  while (!listEmpty(&expired))
+  {
+    Entry *entry = static_cast<Entry *>(expired.next);
+    entry->unlink();
+    if (entry->deadline_ >= current_)
+    {
+      // 期间被refresh过，按照新的deadline重新挂载
+      entry->expire_ = entry->deadline_;
+      place(entry);
+      continue;
+    }
+    --size_;
+    ++count;
+    if (entry->callback_)
+    {
+      // 回调里可能会析构entry所在的对象，之后不能再访问entry
+      entry->callback_(entry->arg_);
+    }
+  }
+  return count;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+// 分层哈希时间轮(参考linux内核早期的timer wheel)
+// 插入/取消/到期都是O(1)，用来管理海量连接的空闲超时
+// 节点是侵入式的，嵌入在使用者(比如TcpConnection)里面，挂载/刷新/取消都不分配内存
+// 非线程安全，只能在所属loop线程中使用
+class TimingWheel : noncopyable
+{
+public:
+  // 双向循环链表节点，每个槽位的表头也是一个Node
+  struct Node
+  {
+    Node *prev;
+    Node *next;
+  };
+
+  class Entry : private Node, noncopyable
+  {
+  public:
+    // 到期回调，arg为设置时传入的参数
+    using Callback = void (*)(void *arg);
+
+    Entry()
+        : wheel_(nullptr),
+          expire_(0),
+          deadline_(0),
+          callback_(nullptr),
+          arg_(nullptr)
+    {
+      prev = next = nullptr;
+    }
+    // 还挂着时从所属的时间轮上取消，size()随之减少
+    ~Entry()
+    {
+      if (armed())
+      {
+        wheel_->cancel(this);
+      }
+    }
+
+    void setCallback(Callback cb, void *arg)
+    {
+      callback_ = cb;
+      arg_ = arg;
+    }
+
+    bool armed() const { return next != nullptr; }
+
+  private:
+    friend class TimingWheel;
+    void unlink();
+
+    TimingWheel *wheel_; // 最近一次挂载到的时间轮
+    uint64_t expire_;   // 当前所在槽位对应的tick
+    uint64_t deadline_; // 真正的到期tick，刷新时只修改它
+    Callback callback_;
+    void *arg_;
+  };
+
+  TimingWheel();
+  ~TimingWheel();
+
+  // 在ticks个tick之后到期，已经挂载的节点会被移动
+  void add(Entry *entry, uint64_t ticks);
+  // 推迟到期时间，只修改deadline，不移动节点，到达原槽位时再重新挂载
+  // 未挂载的节点等价于add
+  void refresh(Entry *entry, uint64_t ticks);
+  // 取消，未挂载时什么都不做
+  void cancel(Entry *entry);
+
+  // 时间前进一个tick，执行所有到期节点的回调，返回到期的数量
+  size_t tick();
+
+  uint64_t currentTick() const { return current_; }
+  size_t size() const { return size_; }
+
+private:
+  static const int kRootBits = 8;
+  static const int kLevelBits = 6;
+  static const int kRootSize = 1 << kRootBits;
+  static const int kLevelSize = 1 << kLevelBits;
+  static const int kRootMask = kRootSize - 1;
+  static const int kLevelMask = kLevelSize - 1;
+  static const int kNumLevels = 4; // 除了根轮之外的层数，共覆盖2^32个tick
+
+  static void initList(Node *head);
+  static bool listEmpty(const Node *head) { return head->next == head; }
+  static void listAppend(Node *head, Node *node);
+  // 把from链表整个搬到to，from置空
+  static void listSplice(Node *from, Node *to);
+
+  // 按照expire_放入对应层的槽位
+  void place(Entry *entry);
+  // 把第level层当前槽位的节点重新分配到更低的层，返回该槽位下标
+  int cascade(int level);
+  int levelIndex(int level) const
+  {
+    return static_cast<int>((current_ >> (kRootBits + level * kLevelBits)) & kLevelMask);
+  }
+
+  uint64_t current_;
+  size_t size_;
+  Node root_[kRootSize];
+  Node levels_[kNumLevels][kLevelSize];
+};
@@ -0,0 +1,340 @@
+#include "Tracer.h"
+#include "CurrentThread.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> Tracer::g_enabled(false);
+
+namespace
+{
+  // 命名事件的name，和span区分开
+  const char kFdName[] = "fd_name";
+
+  struct Event
+  {
+    uint64_t begin;
+    uint64_t end;
+    const char *name;
+    int32_t fd;
+    // 以下只有命名事件使用
+    char label[35];
+    bool renamed; // 同一个连接再次记名字，不是新连接第一次出现
+  };
+  static_assert(sizeof(Event) == 64, "one event per cache line");
+  static_assert((Tracer::kCapacity & (Tracer::kCapacity - 1)) == 0, "capacity must be a power of two");
+
+  // 只有所属线程写，pos_之前的事件写完之后才发布，dump的线程随时可以读
+  // 线程退出后缓冲区不释放，里面的事件还可以dump
+  struct ThreadBuffer
+  {
+    int tid;
+    char threadName[16];
+    std::atomic<uint64_t> pos;
+    Event events[Tracer::kCapacity];
+  };
+
+  std::mutex g_mutex;
+  std::vector<ThreadBuffer *> g_buffers;
+  thread_local ThreadBuffer *t_buffer = nullptr;
+
+  // 换算时间戳用的基准点，setEnabled(true)时更新
+  std::atomic<uint64_t> g_baseTicks(0);
+  std::atomic<uint64_t> g_baseNanoSeconds(0);
+
+  ThreadBuffer *threadBuffer()
+  {
+    if (__builtin_expect(t_buffer == nullptr, 0))
+    {
+      ThreadBuffer *buffer = new ThreadBuffer;
+      buffer->tid = CurrentThread::tid();
+      if (::pthread_getname_np(::pthread_self(), buffer->threadName, sizeof buffer->threadName) != 0)
+      {
+        buffer->threadName[0] = '\0';
+      }
+      buffer->pos.store(0, std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(g_mutex);
+      g_buffers.push_back(buffer);
+      t_buffer = buffer;
+    }
+    return t_buffer;
+  }
+
+  Event *nextEvent(ThreadBuffer *buffer, uint64_t *pos)
+  {
+    *pos = buffer->pos.load(std::memory_order_relaxed);
+    return &buffer->events[*pos & (Tracer::kCapacity - 1)];
+  }
+
+  void appendJsonString(std::string *out, const char *s)
+  {
+    out->push_back('"');
+    for (; *s; ++s)
+    {
+      unsigned char c = static_cast<unsigned char>(*s);
+      if (c == '"' || c == '\\')
+      {
+        out->push_back('\\');
+        out->push_back(c);
+      }
+      else if (c < 0x20)
+      {
+        char buf[8];
+        snprintf(buf, sizeof buf, "\\u%04x", c);
+        out->append(buf);
+      }
+      else
+      {
+        out->push_back(c);
+      }
+    }
+    out->push_back('"');
+  }
+
+  // dumpOnSignal用的管道和输出路径
+  int g_signalPipe[2] = {-1, -1};
+  std::string g_signalPath;
+
+  void onDumpSignal(int)
+  {
+    int savedErrno = errno;
+    char c = 1;
+    ssize_t n = ::write(g_signalPipe[1], &c, 1);
+    (void)n;
+    errno = savedErrno;
+  }
+
+  void signalDumpThread()
+  {
+    char c;
+    while (::read(g_signalPipe[0], &c, 1) > 0 || errno == EINTR)
+    {
+      std::string path;
+      {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        path = g_signalPath;
+      }
+      int n = Tracer::dump(path);
+      LOG_INFO("Tracer dumped %d events to %s \n", n, path.c_str());
+    }
+  }
+}
+
+uint64_t Tracer::nowNanoSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void Tracer::setEnabled(bool on)
+{
+  if (on)
+  {
+    g_baseNanoSeconds.store(nowNanoSeconds(), std::memory_order_relaxed);
+    g_baseTicks.store(now(), std::memory_order_relaxed);
+  }
+  g_enabled.store(on, std::memory_order_relaxed);
+}
+
+void Tracer::record(const char *name, int fd, uint64_t begin, uint64_t end)
+{
+  ThreadBuffer *buffer = threadBuffer();
+  uint64_t pos;
+  Event *event = nextEvent(buffer, &pos);
+  event->begin = begin;
+  event->end = end;
+  event->name = name;
+  event->fd = fd;
+  buffer->pos.store(pos + 1, std::memory_order_release);
+}
+
+void Tracer::nameFd(int fd, const std::string &name, uint64_t *mark)
+{
+  ThreadBuffer *buffer = threadBuffer();
+  uint64_t pos;
+  // 上次的命名事件还在缓冲区较新的一半里，不用再记
+  if (*mark != 0 && buffer->pos.load(std::memory_order_relaxed) - *mark < kCapacity / 2)
+  {
+    return;
+  }
+  Event *event = nextEvent(buffer, &pos);
+  event->begin = now();
+  event->end = event->begin;
+  event->name = kFdName;
+  event->fd = fd;
+  size_t len = std::min(name.size(), sizeof event->label - 1);
+  ::memcpy(event->label, name.data(), len);
+  event->label[len] = '\0';
+  event->renamed = *mark != 0;
+  buffer->pos.store(pos + 1, std::memory_order_release);
+  *mark = pos + 1;
+}
+
+int Tracer::dump(const std::string &path)
+{
+  // 两个基准点相隔太近时换算误差大，至少隔10ms
+  uint64_t baseNanoSeconds = g_baseNanoSeconds.load(std::memory_order_relaxed);
+  uint64_t baseTicks = g_baseTicks.load(std::memory_order_relaxed);
+  if (nowNanoSeconds() - baseNanoSeconds < 10 * 1000 * 1000)
+  {
+    ::usleep(10 * 1000);
+  }
+  uint64_t nowTicks = now();
+  uint64_t nowNs = nowNanoSeconds();
+  double nanoSecondsPerTick = nowTicks > baseTicks
+                                  ? static_cast<double>(nowNs - baseNanoSeconds) / (nowTicks - baseTicks)
+                                  : 1.0;
+  auto toMicroSeconds = [&](uint64_t ticks)
+  {
+    double ns = static_cast<double>(static_cast<int64_t>(ticks - baseTicks)) * nanoSecondsPerTick;
+    return (baseNanoSeconds + ns) / 1000.0;
+  };
+
+  std::vector<ThreadBuffer *> buffers;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    buffers = g_buffers;
+  }
+
+  FILE *fp = ::fopen(path.c_str(), "w");
+  if (fp == nullptr)
+  {
+    LOG_ERROR("Tracer::dump open %s failed, errno = %d \n", path.c_str(), errno);
+    return -1;
+  }
+  int pid = ::getpid();
+  int count = 0;
+  std::string out("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  std::vector<Event> events;
+  for (ThreadBuffer *buffer : buffers)
+  {
+    char line[256];
+    snprintf(line, sizeof line, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+             pid, buffer->tid);
+    out += line;
+    appendJsonString(&out, buffer->threadName[0] ? buffer->threadName : "thread");
+    out += "}},\n";
+
+    // 先拷出来，拷贝期间被所属线程覆盖掉的事件不要
+    uint64_t end = buffer->pos.load(std::memory_order_acquire);
+    uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+    events.clear();
+    for (uint64_t i = begin; i < end; ++i)
+    {
+      events.push_back(buffer->events[i & (kCapacity - 1)]);
+    }
+    // 所属线程可能正在写after这个位置，它和after - kCapacity是同一个槽位，也要丢掉
+    uint64_t after = buffer->pos.load(std::memory_order_acquire);
+    size_t skip = after >= kCapacity && after - kCapacity + 1 > begin ? after - kCapacity + 1 - begin : 0;
+    skip = std::min(skip, events.size());
+    // 被写了一半的命名事件label可能没有结尾的'\0'
+    for (Event &event : events)
+    {
+      event.label[sizeof event.label - 1] = '\0';
+    }
+
+    // 连接的第一个命名事件已经被覆盖时，往后找同一个连接再次记下的名字：
+    // 后面最近的命名事件是renamed，说明那个连接在这之前就已经占着这个fd
+    std::vector<const char *> laterNames(events.size(), nullptr);
+    std::map<int, const Event *> nextNames;
+    for (size_t i = events.size(); i-- > skip;)
+    {
+      const Event &event = events[i];
+      if (event.name == kFdName)
+      {
+        nextNames[event.fd] = &event;
+      }
+      else if (event.fd >= 0)
+      {
+        auto it = nextNames.find(event.fd);
+        if (it != nextNames.end() && it->second->renamed)
+        {
+          laterNames[i] = it->second->label;
+        }
+      }
+    }
+
+    std::map<int, const char *> fdNames;
+    for (size_t i = skip; i < events.size(); ++i)
+    {
+      const Event &event = events[i];
+      if (event.name == kFdName)
+      {
+        fdNames[event.fd] = event.label;
+        continue;
+      }
+      snprintf(line, sizeof line, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+               event.name, pid, buffer->tid, toMicroSeconds(event.begin),
+               (event.end - event.begin) * nanoSecondsPerTick / 1000.0);
+      out += line;
+      if (event.fd >= 0)
+      {
+        snprintf(line, sizeof line, ",\"args\":{\"fd\":%d", event.fd);
+        out += line;
+        auto it = fdNames.find(event.fd);
+        const char *conn = it != fdNames.end() ? it->second : laterNames[i];
+        if (conn != nullptr)
+        {
+          out += ",\"conn\":";
+          appendJsonString(&out, conn);
+        }
+        out += "}";
+      }
+      out += "},\n";
+      ++count;
+    }
+    ::fwrite(out.data(), 1, out.size(), fp);
+    out.clear();
+  }
+  // 最后一个事件后面不能有逗号，补一个空的元数据事件
+  out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":";
+  out += std::to_string(pid);
+  out += ",\"args\":{\"name\":\"mymuduo\"}}\n]}\n";
+  ::fwrite(out.data(), 1, out.size(), fp);
+  bool ok = ::ferror(fp) == 0;
+  ok = ::fclose(fp) == 0 && ok;
+  return ok ? count : -1;
+}
+
+bool Tracer::dumpOnSignal(int signo, const std::string &path)
+{
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_signalPath = path;
+    if (g_signalPipe[0] < 0)
+    {
+      if (::pipe2(g_signalPipe, O_CLOEXEC) < 0)
+      {
+        LOG_ERROR("Tracer::dumpOnSignal pipe failed, errno = %d \n", errno);
+        return false;
+      }
+      // 写端非阻塞，dump期间连续收到信号时多出来的直接丢掉
+      ::fcntl(g_signalPipe[1], F_SETFL, O_NONBLOCK);
+      std::thread(signalDumpThread).detach();
+    }
+  }
+  struct sigaction sa;
+  ::memset(&sa, 0, sizeof sa);
+  sa.sa_handler = onDumpSignal;
+  sa.sa_flags = SA_RESTART;
+  ::sigemptyset(&sa.sa_mask);
+  if (::sigaction(signo, &sa, nullptr) < 0)
+  {
+    LOG_ERROR("Tracer::dumpOnSignal sigaction(%d) failed, errno = %d \n", signo, errno);
+    return false;
+  }
+  return true;
+}
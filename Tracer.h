@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#include "noncopyable.h"
+
+// 用来分析长尾延迟的span记录器，输出Chrome/Perfetto的trace event JSON
+// 每个线程一个环形缓冲区，只保留最近的kCapacity个事件，打开之后一直覆盖写，
+// 需要时dump出来，适合在线上打开几秒钟抓一次现场
+// EventLoop记录每次poll和每个pendingFunctor，Channel记录每个事件回调，
+// 回调的fd通过TcpConnection处理事件时记下的名字对应到连接名
+namespace Tracer
+{
+  // 每个线程的环形缓冲区能放的事件数，每个事件64字节
+  const size_t kCapacity = 16384;
+
+  extern std::atomic<bool> g_enabled;
+
+  inline bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+  // 打开或关闭记录，任意线程可以调用，缓冲区里已有的事件保留到被覆盖为止
+  void setEnabled(bool on);
+
+  uint64_t nowNanoSeconds();
+  // 取时间戳，x86上是rdtsc，dump时再换算成微秒
+  inline uint64_t now()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return nowNanoSeconds();
+#endif
+  }
+
+  // 记录一个完整的span，name必须是字符串常量
+  void record(const char *name, int fd, uint64_t begin, uint64_t end);
+  // 记下fd从现在起对应的连接名，dump时附在本线程这个fd之后的span上
+  // 连接在自己的loop线程里处理事件时调用，mark由调用者保存，初始为0，
+  // 只有第一次或者上次记下的名字快要被环形缓冲区覆盖时才会再记一次
+  void nameFd(int fd, const std::string &name, uint64_t *mark);
+
+  // 把所有线程缓冲区里的事件写成JSON文件，返回写出的事件数，失败返回-1
+  // 可以在记录的同时调用，正在被覆盖的事件会被丢掉
+  int dump(const std::string &path);
+
+  // 收到signo时把事件dump到path，信号处理函数里只写一个管道，
+  // 由后台线程完成dump，返回false表示安装失败
+  bool dumpOnSignal(int signo, const std::string &path);
+}
+
+// 作用域内的span，没有打开记录时只多一次load和一次分支
+class TraceSpan : noncopyable
+{
+public:
+  TraceSpan(const char *name, int fd)
+      : name_(name),
+        fd_(fd),
+        begin_(Tracer::enabled() ? Tracer::now() : 0)
+  {
+  }
+  ~TraceSpan()
+  {
+    if (begin_ != 0)
+    {
+      Tracer::record(name_, fd_, begin_, Tracer::now());
+    }
+  }
+
+private:
+  const char *name_;
+  int fd_;
+  uint64_t begin_;
+};
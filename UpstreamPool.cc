@@ -0,0 +1,193 @@
+#include "UpstreamPool.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+#include <stdio.h>
+#include <strings.h>
+#include <algorithm>
+#include <sys/socket.h>
+
+// 空闲连接上收到的数据没有人要，直接丢弃
+static void discardMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+  buf->retrieveAll();
+}
+
+UpstreamPool::UpstreamPool(EventLoop *loop, const InetAddress &serverAddr, const std::string &name)
+    : loop_(loop),
+      serverAddr_(serverAddr),
+      name_(name),
+      maxIdle_(16),
+      idleTimeout_(0),
+      nextConnId_(1),
+      connects_(0),
+      reused_(0),
+      alive_(std::make_shared<bool>(true))
+{
+}
+
+UpstreamPool::~UpstreamPool()
+{
+  for (auto &connector : connectors_)
+  {
+    connector->stop();
+  }
+  for (auto &item : connections_)
+  {
+    TcpConnectionPtr conn(item.second);
+    // 断开时不再回调到已经析构的连接池
+    conn->setCloseCallback([](const TcpConnectionPtr &) {});
+    loop_->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+  }
+}
+
+void UpstreamPool::acquire(AcquireCallback cb)
+{
+  if (!idle_.empty())
+  {
+    TcpConnectionPtr conn(std::move(idle_.back()));
+    idle_.pop_back();
+    ++reused_;
+    cb(conn);
+    return;
+  }
+  waiters_.push_back(std::move(cb));
+  // 正在建立的连接不够分给排队的请求时再发起一个
+  if (connectors_.size() < waiters_.size())
+  {
+    startConnect();
+  }
+}
+
+void UpstreamPool::release(const TcpConnectionPtr &conn)
+{
+  std::weak_ptr<bool> alive(alive_);
+  loop_->queueInLoop([this, alive, conn]()
+                     {
+    if (alive.lock())
+    {
+      releaseInLoop(conn);
+    } });
+}
+
+void UpstreamPool::releaseInLoop(const TcpConnectionPtr &conn)
+{
+  if (!conn->connected())
+  {
+    // 已经断开，removeConnection会清理
+    return;
+  }
+  conn->setMessageCallback(discardMessage);
+  if (maxIdle_ == 0)
+  {
+    // 不复用，每个请求一条连接
+    conn->forceClose();
+  }
+  else if (!waiters_.empty())
+  {
+    AcquireCallback cb(std::move(waiters_.front()));
+    waiters_.pop_front();
+    ++reused_;
+    cb(conn);
+  }
+  else if (idle_.size() < maxIdle_)
+  {
+    idle_.push_back(conn);
+  }
+  else
+  {
+    conn->forceClose();
+  }
+}
+
+void UpstreamPool::startConnect()
+{
+  std::shared_ptr<Connector> connector(new Connector(loop_, serverAddr_));
+  connector->setNewConnectionCallback(std::bind(&UpstreamPool::newConnection, this, connector.get(), std::placeholders::_1));
+  connector->setConnectFailedCallback(std::bind(&UpstreamPool::connectFailed, this, connector.get(), std::placeholders::_1));
+  connectors_.push_back(connector);
+  ++connects_;
+  connector->start();
+}
+
+void UpstreamPool::removeConnector(Connector *connector)
+{
+  for (auto it = connectors_.begin(); it != connectors_.end(); ++it)
+  {
+    if (it->get() == connector)
+    {
+      // 回调是从Connector里发起的，调用栈上还有它的shared_ptr，这里可以直接删
+      connectors_.erase(it);
+      break;
+    }
+  }
+}
+
+void UpstreamPool::connectFailed(Connector *connector, int err)
+{
+  LOG_ERROR("UpstreamPool::connectFailed [%s] - %s errno = %d\n", name_.c_str(), serverAddr_.toIpPort().c_str(), err);
+  removeConnector(connector);
+  // 这个connector是为最前面的请求发起的，它连不上就让这个请求失败，
+  // 否则connectors_和waiters_一样多，不会再发起新的connect，请求永远等不到连接
+  if (!waiters_.empty())
+  {
+    AcquireCallback cb(std::move(waiters_.front()));
+    waiters_.pop_front();
+    cb(TcpConnectionPtr());
+  }
+}
+
+void UpstreamPool::newConnection(Connector *connector, int sockfd)
+{
+  removeConnector(connector);
+
+  sockaddr_in local;
+  socklen_t addrlen = sizeof local;
+  ::bzero(&local, sizeof local);
+  ::getsockname(sockfd, (sockaddr *)&local, &addrlen);
+  char buf[64];
+  snprintf(buf, sizeof buf, ":%s#%d", serverAddr_.toIpPort().c_str(), nextConnId_);
+  ++nextConnId_;
+  std::string connName = name_ + buf;
+
+  TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, InetAddress(local), serverAddr_));
+  conn->setConnectionCallback(std::bind(&UpstreamPool::onConnection, this, std::placeholders::_1));
+  conn->setMessageCallback(discardMessage);
+  conn->setCloseCallback(std::bind(&UpstreamPool::removeConnection, this, std::placeholders::_1));
+  conn->setIdleTimeout(idleTimeout_);
+  connections_[connName] = conn;
+  conn->connectEstablished();
+
+  if (!waiters_.empty())
+  {
+    AcquireCallback cb(std::move(waiters_.front()));
+    waiters_.pop_front();
+    cb(conn);
+  }
+  else
+  {
+    releaseInLoop(conn);
+  }
+}
+
+void UpstreamPool::onConnection(const TcpConnectionPtr &conn)
+{
+  if (connectionCallback_)
+  {
+    connectionCallback_(conn);
+  }
+}
+
+void UpstreamPool::removeConnection(const TcpConnectionPtr &conn)
+{
+  LOG_INFO("UpstreamPool::removeConnection [%s] - connection %s\n", name_.c_str(), conn->name().c_str());
+  auto it = std::find(idle_.begin(), idle_.end(), conn);
+  if (it != idle_.end())
+  {
+    idle_.erase(it);
+  }
+  connections_.erase(conn->name());
+  loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
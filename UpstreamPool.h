@@ -0,0 +1,78 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+
+class Connector;
+class EventLoop;
+
+// 到一个上游服务的keep-alive连接池，每个loop各建一个，只能在这个loop线程里使用，析构也必须在这个loop线程里
+// 用完归还的连接留在空闲列表里，下一个请求直接复用，不重新握手，也不跨线程
+// 用法：acquire拿到连接后设置这次请求的messageCallback并发送，收完响应release
+class UpstreamPool : noncopyable
+{
+public:
+  // 拿到可用连接后在loop线程里回调；connect遇到不会重试的错误时回调空指针
+  using AcquireCallback = std::function<void(const TcpConnectionPtr &)>;
+
+  UpstreamPool(EventLoop *loop, const InetAddress &serverAddr, const std::string &name);
+  ~UpstreamPool();
+
+  // 最多保留几个空闲连接，多出来的归还时直接关闭；0表示不复用，每个请求新建连接
+  void setMaxIdle(size_t n) { maxIdle_ = n; }
+  // 连接多少秒没有读写就关闭，0表示不限
+  void setIdleTimeout(int seconds) { idleTimeout_ = seconds; }
+  // 连接建立和断开(包括请求中途上游断开)时回调
+  void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+
+  // 有空闲连接时直接回调，否则排队等新连接建立，连不上时按Connector的退避一直重试；
+  // 只有connect返回不会重试的错误时，才以空指针回调一个排队的请求
+  void acquire(AcquireCallback cb);
+  // 归还连接，messageCallback会被重置，迟到的数据直接丢弃
+  // 通常是在这个连接的messageCallback里调用，真正的归还推迟到本轮事件处理完，
+  // 避免替换正在执行的回调；连接池在这之前析构时，排队的归还不再执行
+  void release(const TcpConnectionPtr &conn);
+
+  size_t idleConnections() const { return idle_.size(); }
+  size_t totalConnections() const { return connections_.size(); }
+  size_t pendingRequests() const { return waiters_.size(); }
+  // 发起过的connect次数和复用空闲连接的次数
+  uint64_t connects() const { return connects_; }
+  uint64_t reused() const { return reused_; }
+
+private:
+  void releaseInLoop(const TcpConnectionPtr &conn);
+  void startConnect();
+  void newConnection(Connector *connector, int sockfd);
+  void connectFailed(Connector *connector, int err);
+  void removeConnector(Connector *connector);
+  void onConnection(const TcpConnectionPtr &conn);
+  void removeConnection(const TcpConnectionPtr &conn);
+
+  EventLoop *loop_;
+  const InetAddress serverAddr_;
+  const std::string name_;
+  size_t maxIdle_;
+  int idleTimeout_;
+  ConnectionCallback connectionCallback_;
+
+  // 后进先出，最近用过的连接最热
+  std::vector<TcpConnectionPtr> idle_;
+  std::deque<AcquireCallback> waiters_;
+  std::vector<std::shared_ptr<Connector>> connectors_; // 正在建立的连接
+  std::unordered_map<std::string, TcpConnectionPtr> connections_;
+  int nextConnId_;
+  uint64_t connects_;
+  uint64_t reused_;
+  // release排队的归还只持有它的weak_ptr，析构之后就不再回到连接池
+  std::shared_ptr<bool> alive_;
+};
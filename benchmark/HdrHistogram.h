@@ -0,0 +1,204 @@
+#pragma once
+
+// 压测用的HDR直方图，和HdrHistogram的桶划分相同：
+// 每个2的幂区间等分成subBucketCount个桶，在整个量程上保持固定的有效数字，
+// 记录一次只是算下标加一，不分配内存；不是线程安全的，每个线程一个，最后add合并
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+class HdrHistogram
+{
+public:
+  // 可记录[1, highestTrackableValue]，significantFigures为1~5，超出量程的值按最大值记录
+  HdrHistogram(int64_t highestTrackableValue, int significantFigures)
+      : highestTrackableValue_(highestTrackableValue),
+        totalCount_(0),
+        min_(INT64_MAX),
+        max_(0)
+  {
+    int64_t largestSingleUnitResolution = 2 * static_cast<int64_t>(pow(10, significantFigures));
+    int subBucketCountMagnitude = static_cast<int>(ceil(log2(static_cast<double>(largestSingleUnitResolution))));
+    subBucketHalfCountMagnitude_ = (subBucketCountMagnitude > 1 ? subBucketCountMagnitude : 1) - 1;
+    subBucketCount_ = static_cast<int64_t>(1) << (subBucketHalfCountMagnitude_ + 1);
+    subBucketHalfCount_ = subBucketCount_ / 2;
+    subBucketMask_ = subBucketCount_ - 1;
+
+    int64_t smallestUntrackableValue = subBucketCount_;
+    int bucketsNeeded = 1;
+    while (smallestUntrackableValue <= highestTrackableValue)
+    {
+      if (smallestUntrackableValue > INT64_MAX / 2)
+      {
+        ++bucketsNeeded;
+        break;
+      }
+      smallestUntrackableValue <<= 1;
+      ++bucketsNeeded;
+    }
+    bucketCount_ = bucketsNeeded;
+    counts_.assign((bucketCount_ + 1) * subBucketHalfCount_, 0);
+  }
+
+  void record(int64_t value)
+  {
+    if (value < 0)
+    {
+      value = 0;
+    }
+    if (value > highestTrackableValue_)
+    {
+      value = highestTrackableValue_;
+    }
+    ++counts_[countsIndexFor(value)];
+    ++totalCount_;
+    min_ = value < min_ ? value : min_;
+    max_ = value > max_ ? value : max_;
+  }
+
+  // 参数的量程和精度必须相同
+  void add(const HdrHistogram &other)
+  {
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+      counts_[i] += other.counts_[i];
+    }
+    totalCount_ += other.totalCount_;
+    min_ = other.min_ < min_ ? other.min_ : min_;
+    max_ = other.max_ > max_ ? other.max_ : max_;
+  }
+
+  void reset()
+  {
+    counts_.assign(counts_.size(), 0);
+    totalCount_ = 0;
+    min_ = INT64_MAX;
+    max_ = 0;
+  }
+
+  int64_t count() const { return totalCount_; }
+  int64_t min() const { return totalCount_ > 0 ? min_ : 0; }
+  int64_t max() const { return max_; }
+
+  double mean() const
+  {
+    if (totalCount_ == 0)
+    {
+      return 0;
+    }
+    double sum = 0;
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+      if (counts_[i] > 0)
+      {
+        sum += static_cast<double>(counts_[i]) * medianEquivalentValue(valueFromCountsIndex(i));
+      }
+    }
+    return sum / totalCount_;
+  }
+
+  // 返回所在桶的最大等价值，和HdrHistogram的getValueAtPercentile一致
+  int64_t valueAtPercentile(double percentile) const
+  {
+    if (totalCount_ == 0)
+    {
+      return 0;
+    }
+    int64_t countAtPercentile = static_cast<int64_t>(ceil(percentile / 100 * totalCount_));
+    countAtPercentile = countAtPercentile > 1 ? countAtPercentile : 1;
+    int64_t cumulative = 0;
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+      cumulative += counts_[i];
+      if (cumulative >= countAtPercentile)
+      {
+        int64_t value = highestEquivalentValue(valueFromCountsIndex(i));
+        return value < max_ ? value : max_;
+      }
+    }
+    return max_;
+  }
+
+  // 非空的桶，[[桶的最大等价值, 个数], ...]，可以在别处重建完整的直方图
+  std::string bucketsJson() const
+  {
+    std::string out("[");
+    char buf[64];
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+      if (counts_[i] > 0)
+      {
+        snprintf(buf, sizeof buf, "%s[%lld,%lld]", out.size() > 1 ? "," : "",
+                 static_cast<long long>(highestEquivalentValue(valueFromCountsIndex(i))),
+                 static_cast<long long>(counts_[i]));
+        out += buf;
+      }
+    }
+    out += "]";
+    return out;
+  }
+
+private:
+  int bucketIndexFor(int64_t value) const
+  {
+    return 64 - __builtin_clzll(static_cast<uint64_t>(value) | subBucketMask_) - (subBucketHalfCountMagnitude_ + 1);
+  }
+
+  size_t countsIndexFor(int64_t value) const
+  {
+    int bucketIndex = bucketIndexFor(value);
+    int64_t subBucketIndex = value >> bucketIndex;
+    return static_cast<size_t>(((static_cast<int64_t>(bucketIndex) + 1) << subBucketHalfCountMagnitude_) +
+                               (subBucketIndex - subBucketHalfCount_));
+  }
+
+  int64_t valueFromCountsIndex(size_t index) const
+  {
+    int bucketIndex = static_cast<int>(index >> subBucketHalfCountMagnitude_) - 1;
+    int64_t subBucketIndex = static_cast<int64_t>(index & (subBucketHalfCount_ - 1)) + subBucketHalfCount_;
+    if (bucketIndex < 0)
+    {
+      subBucketIndex -= subBucketHalfCount_;
+      bucketIndex = 0;
+    }
+    return subBucketIndex << bucketIndex;
+  }
+
+  int64_t sizeOfEquivalentRange(int64_t value) const
+  {
+    int bucketIndex = bucketIndexFor(value);
+    int64_t subBucketIndex = value >> bucketIndex;
+    int adjustedBucket = subBucketIndex >= subBucketCount_ ? bucketIndex + 1 : bucketIndex;
+    return static_cast<int64_t>(1) << adjustedBucket;
+  }
+
+  int64_t lowestEquivalentValue(int64_t value) const
+  {
+    int bucketIndex = bucketIndexFor(value);
+    return (value >> bucketIndex) << bucketIndex;
+  }
+
+  int64_t highestEquivalentValue(int64_t value) const
+  {
+    return lowestEquivalentValue(value) + sizeOfEquivalentRange(value) - 1;
+  }
+
+  int64_t medianEquivalentValue(int64_t value) const
+  {
+    return lowestEquivalentValue(value) + (sizeOfEquivalentRange(value) >> 1);
+  }
+
+  int64_t highestTrackableValue_;
+  int subBucketHalfCountMagnitude_;
+  int64_t subBucketCount_;
+  int64_t subBucketHalfCount_;
+  int64_t subBucketMask_;
+  int bucketCount_;
+  std::vector<int64_t> counts_;
+  int64_t totalCount_;
+  int64_t min_;
+  int64_t max_;
+};
@@ -0,0 +1,261 @@
+// 监听socket的accept开销和fd耗尽时的表现
+//   1. 连接风暴：客户端一次发起一批非阻塞connect，对比每次可读事件最多accept 1/16/64个连接时
+//      每个连接平均的唤醒次数和耗时
+//   2. fd耗尽：调低RLIMIT_NOFILE让accept返回EMFILE，检查多出来的连接被立即关掉、
+//      loop不会空转，恢复之后还能正常接受连接，检查失败时返回1
+// 用法: accept_bench [每批的连接数，默认500] [批数，默认20]
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9996;
+
+  std::atomic<int> g_closed(0);
+
+  void onConnection(const TcpConnectionPtr &conn)
+  {
+    if (!conn->connected())
+    {
+      ++g_closed;
+    }
+  }
+
+  uint64_t pollCalls(EventLoop *loop)
+  {
+    std::promise<uint64_t> promise;
+    std::future<uint64_t> future = promise.get_future();
+    loop->queueInLoop([loop, &promise]()
+                      { promise.set_value(loop->pollCalls()); });
+    return future.get();
+  }
+
+  // 条件在timeoutMs内成立返回true
+  template <typename Pred>
+  bool waitFor(Pred pred, int timeoutMs)
+  {
+    Timestamp start(Timestamp::now());
+    while (!pred())
+    {
+      if (timeDifference(Timestamp::now(), start) * 1000 > timeoutMs)
+      {
+        return false;
+      }
+      ::usleep(1000);
+    }
+    return true;
+  }
+
+  void closeAll(std::vector<int> *fds)
+  {
+    struct linger lin = {1, 0};
+    for (int fd : *fds)
+    {
+      ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+      ::close(fd);
+    }
+    fds->clear();
+  }
+
+  void storm(int maxAccepts, int batch, int batches)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "accept_bench", TcpServer::kReusePort);
+    server.setMaxAcceptsPerWakeup(maxAccepts);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                              { buf->retrieveAll(); });
+    g_closed = 0;
+    server.start();
+
+    std::thread client([&]()
+                       {
+      InetAddress addr(kPort);
+      std::vector<int> fds;
+      uint64_t wakeups = server.acceptWakeups();
+      uint64_t polls = pollCalls(&loop);
+      Timestamp start(Timestamp::now());
+      for (int b = 0; b < batches; ++b)
+      {
+        for (int i = 0; i < batch; ++i)
+        {
+          int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+          int ret = ::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in));
+          if (ret < 0 && errno != EINPROGRESS)
+          {
+            perror("connect");
+            exit(1);
+          }
+          fds.push_back(fd);
+        }
+        uint64_t expected = static_cast<uint64_t>(batch) * (b + 1);
+        if (!waitFor([&]()
+                     { return server.acceptedConnections() >= expected; },
+                     10000))
+        {
+          fprintf(stderr, "storm: only %lu of %lu connections accepted\n",
+                  (unsigned long)server.acceptedConnections(), (unsigned long)expected);
+          exit(1);
+        }
+        closeAll(&fds);
+        waitFor([&]()
+                { return g_closed.load() >= static_cast<int>(expected); },
+                10000);
+      }
+      double seconds = timeDifference(Timestamp::now(), start);
+      double total = static_cast<double>(batch) * batches;
+      double accepts = total / (server.acceptWakeups() - wakeups);
+      printf("%11d %12.0f %16.1f %14.3f\n", maxAccepts, total / seconds, accepts,
+             (pollCalls(&loop) - polls) / total);
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+  }
+
+  bool fdExhaustion()
+  {
+    const int kClients = 100;
+    const int kServerFds = 10;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "accept_bench", TcpServer::kReusePort);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                              { buf->retrieveAll(); });
+    g_closed = 0;
+    server.start();
+
+    bool ok = true;
+    std::thread client([&]()
+                       {
+      InetAddress addr(kPort);
+      // 先把客户端的socket都建好，调低上限之后只有服务端在分配fd
+      std::vector<int> fds;
+      for (int i = 0; i < kClients; ++i)
+      {
+        fds.push_back(::socket(AF_INET, SOCK_STREAM, 0));
+      }
+      struct rlimit saved;
+      ::getrlimit(RLIMIT_NOFILE, &saved);
+      struct rlimit low = saved;
+      low.rlim_cur = fds.back() + 1 + kServerFds;
+      ::setrlimit(RLIMIT_NOFILE, &low);
+
+      for (int fd : fds)
+      {
+        if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+        {
+          perror("connect");
+          exit(1);
+        }
+      }
+      bool handled = waitFor([&]()
+                             { return server.acceptedConnections() + server.droppedConnections() >= kClients; },
+                             5000);
+      uint64_t accepted = server.acceptedConnections();
+      uint64_t dropped = server.droppedConnections();
+      printf("fd limit:   accepted %lu, dropped %lu of %d connections\n",
+             (unsigned long)accepted, (unsigned long)dropped, kClients);
+      if (!handled || dropped == 0)
+      {
+        printf("FAIL: pending connections were not shed\n");
+        ok = false;
+      }
+
+      // 多余的连接都处理掉之后监听socket不再可读，loop应该是空闲的
+      uint64_t before = pollCalls(&loop);
+      ::usleep(300 * 1000);
+      uint64_t idlePolls = pollCalls(&loop) - before;
+      printf("fd limit:   %lu polls in 300ms after shedding\n", (unsigned long)idlePolls);
+      if (idlePolls > 10)
+      {
+        printf("FAIL: loop is spinning on the listening socket\n");
+        ok = false;
+      }
+
+      // 被丢弃的连接客户端应该马上看到断开
+      std::vector<pollfd> pfds(fds.size());
+      for (size_t i = 0; i < fds.size(); ++i)
+      {
+        pfds[i].fd = fds[i];
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+      }
+      ::poll(pfds.data(), pfds.size(), 500);
+      uint64_t disconnected = 0;
+      for (const pollfd &p : pfds)
+      {
+        char c;
+        if (p.revents && ::recv(p.fd, &c, 1, MSG_DONTWAIT) <= 0)
+        {
+          ++disconnected;
+        }
+      }
+      printf("fd limit:   %lu client sockets saw the disconnect\n", (unsigned long)disconnected);
+      if (disconnected != dropped)
+      {
+        printf("FAIL: expected %lu disconnected clients\n", (unsigned long)dropped);
+        ok = false;
+      }
+
+      ::setrlimit(RLIMIT_NOFILE, &saved);
+      closeAll(&fds);
+      waitFor([&]()
+              { return g_closed.load() >= static_cast<int>(accepted); },
+              5000);
+
+      // fd恢复之后还能正常接受连接
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0 ||
+          !waitFor([&]()
+                   { return server.acceptedConnections() == accepted + 1; },
+                   5000))
+      {
+        printf("FAIL: no connection accepted after the limit was restored\n");
+        ok = false;
+      }
+      fds.push_back(fd);
+      closeAll(&fds);
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+    return ok;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int batch = argc > 1 ? atoi(argv[1]) : 500;
+  int batches = argc > 2 ? atoi(argv[2]) : 20;
+  // 客户端用RST断开和fd耗尽都会打错误日志，这里不关心
+  Logger::setLogLevel(FATAL);
+
+  printf("%11s %12s %16s %14s\n", "max/wakeup", "conn/s", "accepts/wakeup", "polls/conn");
+  const int kMaxAccepts[] = {1, 16, 64};
+  for (int maxAccepts : kMaxAccepts)
+  {
+    storm(maxAccepts, batch, batches);
+  }
+
+  if (!fdExhaustion())
+  {
+    return 1;
+  }
+  printf("fd limit:   ok\n");
+  return 0;
+}
@@ -0,0 +1,152 @@
+// ioLoop线程绑核和不绑核的延迟对比，走loopback pingpong
+// 服务端若干ioLoop，每个客户端线程一个连接，发64字节等回包，记录每次往返的延迟
+// 绑核时每个loop依次绑到进程可用的CPU上，并打印每个loop实际所在的CPU和NUMA节点
+// 给出网卡名时把它的收发队列中断依次绑到同样的CPU上(需要root)
+// 用法: affinity_bench [ioLoop数，默认CPU数] [每个连接的往返次数，默认5000] [网卡名]
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+#include "CpuAffinity.h"
+
+namespace
+{
+  const uint16_t kPort = 9998;
+  const size_t kMessageSize = 64;
+
+  std::vector<EventLoop *> g_loops;
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  void pingpong(int rounds, std::vector<double> *latencies)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+    {
+      perror("connect");
+      exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    char message[kMessageSize] = {0};
+    char reply[kMessageSize];
+    latencies->reserve(rounds);
+    for (int r = 0; r < rounds; ++r)
+    {
+      Timestamp start(Timestamp::now());
+      if (::write(fd, message, sizeof message) != static_cast<ssize_t>(sizeof message))
+      {
+        perror("write");
+        exit(1);
+      }
+      size_t got = 0;
+      while (got < sizeof reply)
+      {
+        ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+        if (n <= 0)
+        {
+          perror("read");
+          exit(1);
+        }
+        got += n;
+      }
+      latencies->push_back(timeDifference(Timestamp::now(), start) * 1e6);
+    }
+    ::close(fd);
+  }
+
+  // 在每个loop线程里看它实际运行在哪个CPU上
+  void printPlacement()
+  {
+    for (size_t i = 0; i < g_loops.size(); ++i)
+    {
+      std::promise<int> promise;
+      std::future<int> future = promise.get_future();
+      g_loops[i]->runInLoop([&promise]()
+                            { promise.set_value(::sched_getcpu()); });
+      int cpu = future.get();
+      printf("  loop %zu on cpu %d, numa node %d\n", i, cpu, CpuAffinity::numaNode(cpu));
+    }
+  }
+
+  void run(bool pinned, int numLoops, int rounds)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "affinity_bench", TcpServer::kReusePort);
+    server.setThreadNum(numLoops);
+    if (pinned)
+    {
+      server.setThreadAffinity(CpuAffinity::availableCpus());
+    }
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    g_loops.clear();
+    server.setThreadInitcallback([](EventLoop *ioLoop)
+                                 { g_loops.push_back(ioLoop); });
+    server.start();
+
+    std::thread client([&]()
+                       {
+      printf("%s:\n", pinned ? "pinned" : "unpinned");
+      printPlacement();
+      // 每个loop上两个连接
+      int connections = numLoops * 2;
+      std::vector<std::vector<double>> latencies(connections);
+      std::vector<std::thread> threads;
+      for (int i = 0; i < connections; ++i)
+      {
+        threads.emplace_back(pingpong, rounds, &latencies[i]);
+      }
+      for (std::thread &t : threads)
+      {
+        t.join();
+      }
+      std::vector<double> all;
+      for (const std::vector<double> &l : latencies)
+      {
+        all.insert(all.end(), l.begin(), l.end());
+      }
+      std::sort(all.begin(), all.end());
+      printf("  %-8s %10s %10s %10s %10s\n", "", "p50 us", "p99 us", "p99.9 us", "max us");
+      printf("  %-8s %10.1f %10.1f %10.1f %10.1f\n", pinned ? "pinned" : "unpinned",
+             all[all.size() / 2], all[all.size() * 99 / 100], all[all.size() * 999 / 1000], all.back());
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<int> cpus = CpuAffinity::availableCpus();
+  int numLoops = argc > 1 ? atoi(argv[1]) : static_cast<int>(cpus.size());
+  int rounds = argc > 2 ? atoi(argv[2]) : 5000;
+  numLoops = std::max(numLoops, 1);
+  Logger::setLogLevel(ERROR);
+
+  printf("%zu cpus available, %d io loops\n", cpus.size(), numLoops);
+  if (argc > 3)
+  {
+    int n = CpuAffinity::bindNicIrqs(argv[3], cpus);
+    printf("bound %d irqs of %s\n", n, argv[3]);
+  }
+  run(false, numLoops, rounds);
+  run(true, numLoops, rounds);
+  return 0;
+}
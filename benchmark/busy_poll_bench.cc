@@ -0,0 +1,112 @@
+// ioLoop忙轮询的延迟和CPU代价，走loopback pingpong
+// 服务端一个ioLoop，客户端一个连接发64字节等回包，对比不同的空转预算下
+// 往返延迟和loop空转的时间占比；最后一行同时在socket上设置SO_BUSY_POLL
+// 单核机器上空转的loop会和客户端抢CPU，延迟反而变差，结果要在多核上看
+// 用法: busy_poll_bench [每种配置的往返次数，默认20000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9999;
+  const size_t kMessageSize = 64;
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  void run(int busyPollMicroSeconds, bool socketBusyPoll, int rounds)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "busy_poll_bench", TcpServer::kReusePort);
+    server.setThreadNum(1);
+    server.setBusyPoll(busyPollMicroSeconds, socketBusyPoll);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    EventLoop *ioLoop = nullptr;
+    server.setThreadInitcallback([&ioLoop](EventLoop *l)
+                                 { ioLoop = l; });
+    server.start();
+
+    std::thread client([&]()
+                       {
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      InetAddress addr(kPort);
+      if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+      {
+        perror("connect");
+        exit(1);
+      }
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+      char message[kMessageSize] = {0};
+      char reply[kMessageSize];
+      std::vector<double> latencies;
+      latencies.reserve(rounds);
+      Timestamp start(Timestamp::now());
+      for (int r = 0; r < rounds; ++r)
+      {
+        Timestamp sent(Timestamp::now());
+        if (::write(fd, message, sizeof message) != static_cast<ssize_t>(sizeof message))
+        {
+          perror("write");
+          exit(1);
+        }
+        size_t got = 0;
+        while (got < sizeof reply)
+        {
+          ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+          if (n <= 0)
+          {
+            perror("read");
+            exit(1);
+          }
+          got += n;
+        }
+        latencies.push_back(timeDifference(Timestamp::now(), sent) * 1e6);
+      }
+      double seconds = timeDifference(Timestamp::now(), start);
+      // 最近一个统计窗口的值，测量期间一直在跑，可以代表稳态
+      int spin = ioLoop->spinPermille();
+      int busy = ioLoop->busyPermille();
+      ::close(fd);
+
+      std::sort(latencies.begin(), latencies.end());
+      char mode[32];
+      snprintf(mode, sizeof mode, "%d us%s", busyPollMicroSeconds, socketBusyPoll ? " +socket" : "");
+      printf("%-16s %10.0f %8.1f %8.1f %8.1f %8.1f%% %8.1f%%\n", mode, rounds / seconds,
+             latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100],
+             latencies[latencies.size() * 999 / 1000], spin / 10.0, busy / 10.0);
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+  Logger::setLogLevel(ERROR);
+
+  printf("%-16s %10s %8s %8s %8s %9s %9s\n", "busy poll", "rtt/s", "p50 us", "p99 us", "p99.9 us", "spin", "busy");
+  const int kBudgets[] = {0, 20, 100, 1000};
+  for (int budget : kBudgets)
+  {
+    run(budget, false, rounds);
+  }
+  run(100, true, rounds);
+  return 0;
+}
@@ -0,0 +1,206 @@
+// 连接频繁建立断开时Poller里channel表的开销
+//   1. 表操作：按内核分配fd的方式(总是取最小的空闲fd)模拟连接的建立/查找/断开，
+//      对比原来的unordered_map和现在按fd下标的数组，统计耗时和内存分配次数
+//   2. 端到端：客户端线程不停地connect再立刻close(SO_LINGER 0，避免TIME_WAIT耗尽端口)，
+//      服务端TcpServer在主线程的loop上，统计每秒处理的连接数
+// 用法: churn_bench [端到端的连接数，默认50000] [同时在线的连接数，默认1000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <deque>
+#include <new>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+namespace
+{
+  std::atomic<int64_t> g_allocs(0);
+}
+
+void *operator new(size_t size)
+{
+  g_allocs.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size ? size : 1);
+  if (p == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+namespace
+{
+  const uint16_t kPort = 9994;
+
+  // 原来Poller::channels_的做法
+  struct MapTable
+  {
+    std::unordered_map<int, Channel *> map;
+    void set(int fd, Channel *c) { map[fd] = c; }
+    void clear(int fd) { map.erase(fd); }
+    Channel *find(int fd) const
+    {
+      auto it = map.find(fd);
+      return it == map.end() ? nullptr : it->second;
+    }
+  };
+
+  // 现在Poller::channels_的做法
+  struct FlatTable
+  {
+    std::vector<Channel *> table;
+    void set(int fd, Channel *c)
+    {
+      if (static_cast<size_t>(fd) >= table.size())
+      {
+        table.resize(std::max(static_cast<size_t>(fd) + 1, table.size() * 2), nullptr);
+      }
+      table[fd] = c;
+    }
+    void clear(int fd) { table[fd] = nullptr; }
+    Channel *find(int fd) const
+    {
+      return static_cast<size_t>(fd) < table.size() ? table[fd] : nullptr;
+    }
+  };
+
+  // 预先生成fd序列：内核总是分配最小的空闲fd，连接按先进先出断开
+  std::vector<int> makeFdSequence(int ops, int concurrent)
+  {
+    std::set<int> freeFds;
+    for (int fd = 10; fd < 10 + concurrent * 2; ++fd)
+    {
+      freeFds.insert(fd);
+    }
+    std::deque<int> live;
+    std::vector<int> seq;
+    seq.reserve(ops * 2);
+    for (int i = 0; i < ops; ++i)
+    {
+      if (static_cast<int>(live.size()) >= concurrent)
+      {
+        int fd = live.front();
+        live.pop_front();
+        freeFds.insert(fd);
+        seq.push_back(-fd - 1); // 负数表示断开
+      }
+      int fd = *freeFds.begin();
+      freeFds.erase(freeFds.begin());
+      live.push_back(fd);
+      seq.push_back(fd);
+    }
+    return seq;
+  }
+
+  // 每次建立：set + 两次find(updateChannel/hasChannel)，每次断开：find + clear
+  template <typename Table>
+  void tableChurn(const char *name, const std::vector<int> &seq)
+  {
+    Table table;
+    Channel *dummy = reinterpret_cast<Channel *>(0x1000);
+    int64_t allocs = g_allocs.load();
+    Timestamp start(Timestamp::now());
+    size_t found = 0;
+    for (int v : seq)
+    {
+      if (v >= 0)
+      {
+        table.set(v, dummy);
+        found += table.find(v) != nullptr;
+        found += table.find(v) != nullptr;
+      }
+      else
+      {
+        int fd = -v - 1;
+        found += table.find(fd) != nullptr;
+        table.clear(fd);
+      }
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("%-14s %8.1f ns/op %10.3f allocs/op (found %zu)\n", name,
+           seconds * 1e9 / seq.size(), static_cast<double>(g_allocs.load() - allocs) / seq.size(), found);
+  }
+
+  std::atomic<int> g_closed(0);
+
+  void onConnection(const TcpConnectionPtr &conn)
+  {
+    if (!conn->connected())
+    {
+      ++g_closed;
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int connections = argc > 1 ? atoi(argv[1]) : 50000;
+  int concurrent = argc > 2 ? atoi(argv[2]) : 1000;
+  // 客户端用RST断开，服务端每个连接都会打一条handleError日志，这里不关心
+  Logger::setLogLevel(FATAL);
+
+  std::vector<int> seq = makeFdSequence(1000000, concurrent);
+  printf("table churn, %d concurrent connections:\n", concurrent);
+  tableChurn<MapTable>("unordered_map", seq);
+  tableChurn<FlatTable>("flat vector", seq);
+
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort), "churn_bench", TcpServer::kReusePort);
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                            { buf->retrieveAll(); });
+  server.start();
+
+  std::thread client([&]()
+                     {
+    InetAddress addr(kPort);
+    struct linger lin = {1, 0};
+    int64_t allocs = g_allocs.load();
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < connections; ++i)
+    {
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+      {
+        perror("connect");
+        exit(1);
+      }
+      ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+      ::close(fd);
+      // 不让服务端积压太多，模拟稳定的在线连接数
+      while (i - g_closed.load() > concurrent)
+      {
+        std::this_thread::yield();
+      }
+    }
+    while (g_closed.load() < connections)
+    {
+      std::this_thread::yield();
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("end to end:    %8.0f connections/s, %.1f allocs/connection (client+server)\n",
+           connections / seconds, static_cast<double>(g_allocs.load() - allocs) / connections);
+    loop.quit(); });
+
+  loop.loop();
+  client.join();
+  return 0;
+}
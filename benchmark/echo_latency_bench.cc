@@ -0,0 +1,422 @@
+// echo往返延迟，走loopback，服务端和客户端在同一个进程里各用一组ioLoop
+// 客户端按固定速率发送(开环)，不等回包；延迟从这个消息"应该发出"的时间算起，
+// 客户端或服务端卡住时排在后面的消息的等待时间也会算进去，即coordinated omission修正，
+// 同时给出从实际发出时间算起的未修正延迟作对比
+// 每个客户端ioLoop各记一份HDR直方图(纳秒，3位有效数字)，结束时合并，结果以JSON输出到标准输出
+// 用法: echo_latency_bench [-c 连接数，默认8] [-t 服务端和客户端各自的ioLoop数，默认1]
+//                          [-s 消息字节数，默认64] [-r 所有连接合计每秒消息数，默认10000]
+//                          [-d 测量秒数，默认5] [-w 预热秒数，不计入结果，默认1]
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+#include "HdrHistogram.h"
+
+namespace
+{
+  const uint16_t kPort = 9984;
+  // 直方图量程60秒
+  const int64_t kHighestLatencyNs = 60LL * 1000 * 1000 * 1000;
+  // 发送结束之后最多再等这么久的回包
+  const double kDrainSeconds = 10;
+
+  struct Options
+  {
+    int connections = 8;
+    int threads = 1;
+    size_t messageSize = 64;
+    double rate = 10000;
+    double seconds = 5;
+    double warmup = 1;
+  };
+
+  int64_t nowNs()
+  {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  void onServerMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  // 每个客户端ioLoop一份，只在这个loop线程里访问
+  struct LoopStats
+  {
+    LoopStats()
+        : corrected(kHighestLatencyNs, 3),
+          uncorrected(kHighestLatencyNs, 3),
+          sent(0),
+          received(0)
+    {
+    }
+    HdrHistogram corrected;
+    HdrHistogram uncorrected;
+    int64_t sent;
+    int64_t received;
+  };
+
+  class Client;
+
+  // 一个客户端连接，除了构造以外只在所在的loop线程里访问
+  class Session
+  {
+  public:
+    Session(Client *owner, EventLoop *loop, LoopStats *stats, const std::string &name)
+        : owner_(owner),
+          loop_(loop),
+          stats_(stats),
+          client_(new TcpClient(loop, InetAddress(kPort), name)),
+          nextIntended_(0),
+          warmupEnd_(0),
+          stopAt_(0),
+          intervalNs_(0),
+          baseMono_(0),
+          baseReal_(0),
+          sending_(false),
+          notified_(false)
+    {
+    }
+
+    TcpClient *client() { return client_.get(); }
+
+    // 在loop线程里调用，从startMono开始每intervalNs发一个消息
+    void start(const TcpConnectionPtr &conn, const std::string *message, int64_t startMono,
+               int64_t warmupNs, int64_t durationNs, int64_t intervalNs)
+    {
+      conn_ = conn;
+      message_ = message;
+      // 定时器用的是系统时间，两个时钟的差在这里固定下来
+      baseMono_ = nowNs();
+      baseReal_ = Timestamp::now().microSecondsSinceEpoch();
+      nextIntended_ = startMono;
+      warmupEnd_ = startMono + warmupNs;
+      stopAt_ = warmupEnd_ + durationNs;
+      intervalNs_ = intervalNs;
+      sending_ = true;
+      scheduleNext();
+    }
+
+    void onMessage(Buffer *buf);
+
+    bool finished() const { return !sending_ && pending_.empty(); }
+
+  private:
+    struct Pending
+    {
+      int64_t intended;
+      int64_t actual;
+    };
+
+    // 把到期的消息都发出去，定时器来晚了也按原来的节奏补发
+    void sendDue()
+    {
+      int64_t now = nowNs();
+      while (sending_ && nextIntended_ <= now)
+      {
+        conn_->send(message_->data(), message_->size());
+        Pending pending = {nextIntended_, now};
+        pending_.push_back(pending);
+        ++stats_->sent;
+        nextIntended_ += intervalNs_;
+        if (nextIntended_ >= stopAt_)
+        {
+          sending_ = false;
+        }
+      }
+      if (sending_)
+      {
+        scheduleNext();
+      }
+      else if (finished())
+      {
+        notifyFinished();
+      }
+    }
+
+    void scheduleNext()
+    {
+      int64_t realUs = baseReal_ + (nextIntended_ - baseMono_) / 1000;
+      loop_->runAt(Timestamp(realUs), [this]()
+                   { sendDue(); });
+    }
+
+    void notifyFinished();
+
+    Client *owner_;
+    EventLoop *loop_;
+    LoopStats *stats_;
+    std::unique_ptr<TcpClient> client_;
+    TcpConnectionPtr conn_;
+    const std::string *message_;
+    std::deque<Pending> pending_;
+    int64_t nextIntended_;
+    int64_t warmupEnd_;
+    int64_t stopAt_;
+    int64_t intervalNs_;
+    int64_t baseMono_;
+    int64_t baseReal_;
+    bool sending_;
+    bool notified_;
+  };
+
+  class Client
+  {
+  public:
+    Client(EventLoop *loop, const Options &options)
+        : loop_(loop),
+          options_(options),
+          pool_(loop, "latency_client"),
+          message_(options.messageSize, 'x'),
+          connected_(0),
+          finished_(0),
+          disconnected_(0),
+          stopping_(false)
+    {
+      pool_.setThreadNum(options.threads);
+      pool_.start();
+      std::vector<EventLoop *> loops(pool_.getAllLoops());
+      for (size_t i = 0; i < loops.size(); ++i)
+      {
+        stats_.emplace_back(new LoopStats);
+      }
+      for (int i = 0; i < options.connections; ++i)
+      {
+        size_t index = i % loops.size();
+        char name[32];
+        snprintf(name, sizeof name, "latency%d", i);
+        std::unique_ptr<Session> session(new Session(this, loops[index], stats_[index].get(), name));
+        Session *s = session.get();
+        s->client()->setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                           { onConnection(conn); });
+        s->client()->setMessageCallback([s](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                                        { s->onMessage(buf); });
+        sessions_.push_back(std::move(session));
+      }
+      for (auto &session : sessions_)
+      {
+        session->client()->connect();
+      }
+    }
+
+    // 在客户端loop线程里调用
+    void sessionFinished()
+    {
+      if (++finished_ == options_.connections)
+      {
+        loop_->queueInLoop([this]()
+                           { stop(); });
+      }
+    }
+
+    // 在baseLoop线程里调用，所有loop都不再往统计里写之后合并
+    void report()
+    {
+      LoopStats total;
+      for (auto &stats : stats_)
+      {
+        total.corrected.add(stats->corrected);
+        total.uncorrected.add(stats->uncorrected);
+        total.sent += stats->sent;
+        total.received += stats->received;
+      }
+      printf("{\"benchmark\":\"echo_latency\",\"connections\":%d,\"threads\":%d,\"message_size\":%zu,"
+             "\"rate\":%.0f,\"seconds\":%.3f,\"warmup\":%.3f,\"sent\":%lld,\"received\":%lld,"
+             "\"latency_ns\":{\"corrected\":%s,\"uncorrected\":%s}}\n",
+             options_.connections, options_.threads, options_.messageSize, options_.rate,
+             options_.seconds, options_.warmup, static_cast<long long>(total.sent),
+             static_cast<long long>(total.received), histogramJson(total.corrected).c_str(),
+             histogramJson(total.uncorrected).c_str());
+    }
+
+  private:
+    static std::string histogramJson(const HdrHistogram &h)
+    {
+      const double kPercentiles[] = {50, 75, 90, 99, 99.9, 99.99, 99.999};
+      char buf[128];
+      snprintf(buf, sizeof buf, "{\"count\":%lld,\"min\":%lld,\"mean\":%.1f,\"max\":%lld,\"percentiles\":{",
+               static_cast<long long>(h.count()), static_cast<long long>(h.min()), h.mean(),
+               static_cast<long long>(h.max()));
+      std::string out(buf);
+      for (size_t i = 0; i < sizeof kPercentiles / sizeof kPercentiles[0]; ++i)
+      {
+        snprintf(buf, sizeof buf, "%s\"%g\":%lld", i ? "," : "", kPercentiles[i],
+                 static_cast<long long>(h.valueAtPercentile(kPercentiles[i])));
+        out += buf;
+      }
+      out += "},\"buckets\":";
+      out += h.bucketsJson();
+      out += "}";
+      return out;
+    }
+
+    // 在客户端loop线程里调用
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+      if (conn->connected())
+      {
+        conn->setTcpNoDelay(true);
+        if (++connected_ == options_.connections)
+        {
+          loop_->runInLoop([this]()
+                           { startAll(); });
+        }
+      }
+      else if (++disconnected_ == options_.connections)
+      {
+        loop_->quit();
+      }
+    }
+
+    // 以下在baseLoop线程里调用
+    void startAll()
+    {
+      // 各个连接的发送时刻错开，合起来是均匀的rate
+      int64_t intervalNs = static_cast<int64_t>(1e9 * options_.connections / options_.rate);
+      int64_t startMono = nowNs() + 10 * 1000 * 1000;
+      int64_t warmupNs = static_cast<int64_t>(options_.warmup * 1e9);
+      int64_t durationNs = static_cast<int64_t>(options_.seconds * 1e9);
+      for (size_t i = 0; i < sessions_.size(); ++i)
+      {
+        Session *session = sessions_[i].get();
+        TcpConnectionPtr conn(session->client()->connection());
+        int64_t offset = intervalNs * static_cast<int64_t>(i) / options_.connections;
+        const std::string *message = &message_;
+        conn->getLoop()->runInLoop([=]()
+                                   { session->start(conn, message, startMono + offset, warmupNs, durationNs, intervalNs); });
+      }
+      // 服务端跟不上时不会一直等下去
+      loop_->runAfter(options_.warmup + options_.seconds + kDrainSeconds, [this]()
+                      { stop(); });
+    }
+
+    void stop()
+    {
+      if (stopping_)
+      {
+        return;
+      }
+      stopping_ = true;
+      for (auto &session : sessions_)
+      {
+        session->client()->disconnect();
+      }
+    }
+
+    EventLoop *loop_;
+    const Options options_;
+    EventLoopThreadPool pool_;
+    const std::string message_;
+    std::vector<std::unique_ptr<LoopStats>> stats_;
+    std::vector<std::unique_ptr<Session>> sessions_;
+    std::atomic<int> connected_;
+    std::atomic<int> finished_;
+    std::atomic<int> disconnected_;
+    bool stopping_;
+  };
+
+  void Session::onMessage(Buffer *buf)
+  {
+    int64_t now = nowNs();
+    size_t size = message_->size();
+    while (buf->readableBytes() >= size && !pending_.empty())
+    {
+      buf->retrieve(size);
+      Pending pending = pending_.front();
+      pending_.pop_front();
+      ++stats_->received;
+      if (pending.intended >= warmupEnd_)
+      {
+        stats_->corrected.record(now - pending.intended);
+        stats_->uncorrected.record(now - pending.actual);
+      }
+    }
+    if (finished())
+    {
+      notifyFinished();
+    }
+  }
+
+  void Session::notifyFinished()
+  {
+    if (notified_)
+    {
+      return;
+    }
+    notified_ = true;
+    owner_->sessionFinished();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  Options options;
+  int opt;
+  while ((opt = ::getopt(argc, argv, "c:t:s:r:d:w:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'c':
+      options.connections = atoi(optarg);
+      break;
+    case 't':
+      options.threads = atoi(optarg);
+      break;
+    case 's':
+      options.messageSize = static_cast<size_t>(atol(optarg));
+      break;
+    case 'r':
+      options.rate = atof(optarg);
+      break;
+    case 'd':
+      options.seconds = atof(optarg);
+      break;
+    case 'w':
+      options.warmup = atof(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-c connections] [-t threads] [-s message_size] [-r rate] [-d seconds] [-w warmup]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (options.connections <= 0 || options.threads < 0 || options.messageSize == 0 ||
+      options.rate <= 0 || options.seconds <= 0 || options.warmup < 0)
+  {
+    fprintf(stderr, "invalid arguments\n");
+    return 2;
+  }
+  Logger::setLogLevel(ERROR);
+
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort), "latency_server", TcpServer::kReusePort);
+  server.setThreadNum(options.threads);
+  server.setConnectionCallback([](const TcpConnectionPtr &conn)
+                               {
+    if (conn->connected())
+    {
+      conn->setTcpNoDelay(true);
+    } });
+  server.setMessageCallback(onServerMessage);
+  server.start();
+
+  std::unique_ptr<Client> client(new Client(&loop, options));
+  loop.loop();
+  client->report();
+  client.reset();
+  return 0;
+}
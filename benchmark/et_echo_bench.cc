@@ -0,0 +1,303 @@
+// 水平触发和边沿触发的对比，走loopback echo
+// 服务端在主线程的loop上，客户端线程开若干连接，每轮在所有连接上各发一条消息再收回来
+// 统计每条消息平均调用了几次epoll_wait和epoll_ctl，以及合并掉的epoll_ctl次数
+// 最后检查边沿触发下收到可读事件、第一次read就EAGAIN时连接不会被关掉，失败时返回1
+// 用法: et_echo_bench [连接数，默认64] [每个连接的轮数，默认200]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9992;
+
+  struct Counters
+  {
+    uint64_t polls;
+    uint64_t ctls;
+    uint64_t saved;
+  };
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  // 在loop线程里读取计数
+  Counters snapshot(EventLoop *loop)
+  {
+    std::promise<Counters> promise;
+    std::future<Counters> future = promise.get_future();
+    loop->queueInLoop([loop, &promise]()
+                      { promise.set_value(Counters{loop->pollCalls(), loop->pollerCtlCalls(), loop->pollerCtlCallsSaved()}); });
+    return future.get();
+  }
+
+  void fullWrite(int fd, const char *data, size_t len)
+  {
+    while (len > 0)
+    {
+      ssize_t n = ::write(fd, data, len);
+      if (n <= 0)
+      {
+        perror("write");
+        exit(1);
+      }
+      data += n;
+      len -= n;
+    }
+  }
+
+  void fullRead(int fd, char *data, size_t len)
+  {
+    while (len > 0)
+    {
+      ssize_t n = ::read(fd, data, len);
+      if (n <= 0)
+      {
+        perror("read");
+        exit(1);
+      }
+      data += n;
+      len -= n;
+    }
+  }
+
+  void run(bool edgeTriggered, size_t messageSize, int connections, int rounds)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "et_echo_bench", TcpServer::kReusePort);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    server.start();
+
+    std::thread client([&]()
+                       {
+      std::vector<int> fds;
+      for (int i = 0; i < connections; ++i)
+      {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        InetAddress addr(kPort);
+        if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+        {
+          perror("connect");
+          exit(1);
+        }
+        fds.push_back(fd);
+      }
+      std::vector<char> message(messageSize, 'x');
+      std::vector<char> reply(messageSize);
+      // 确保所有连接都已经建立，不把建连的epoll_ctl算进去
+      fullWrite(fds.back(), message.data(), 1);
+      fullRead(fds.back(), reply.data(), 1);
+
+      Counters before = snapshot(&loop);
+      Timestamp start(Timestamp::now());
+      for (int r = 0; r < rounds; ++r)
+      {
+        for (int fd : fds)
+        {
+          fullWrite(fd, message.data(), message.size());
+        }
+        for (int fd : fds)
+        {
+          fullRead(fd, reply.data(), reply.size());
+        }
+      }
+      double seconds = timeDifference(Timestamp::now(), start);
+      Counters after = snapshot(&loop);
+
+      double messages = static_cast<double>(connections) * rounds;
+      printf("%-6s %8zu %10.0f %10.1f %14.3f %14.3f %14.3f\n",
+             edgeTriggered ? "ET" : "LT", messageSize, messages / seconds,
+             messages * messageSize / seconds / (1 << 20),
+             (after.polls - before.polls) / messages,
+             (after.ctls - before.ctls) / messages,
+             (after.saved - before.saved) / messages);
+      for (int fd : fds)
+      {
+        ::close(fd);
+      }
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+  }
+
+  // 本进程里已经接受的、对端端口为peerPort的那个服务端socket
+  int findServerFd(uint16_t peerPort)
+  {
+    for (int fd = 0; fd < 1024; ++fd)
+    {
+      sockaddr_in local, peer;
+      socklen_t len = sizeof local;
+      if (::getsockname(fd, (sockaddr *)&local, &len) < 0 || local.sin_family != AF_INET ||
+          ntohs(local.sin_port) != kPort)
+      {
+        continue;
+      }
+      len = sizeof peer;
+      if (::getpeername(fd, (sockaddr *)&peer, &len) == 0 && ntohs(peer.sin_port) == peerPort)
+      {
+        return fd;
+      }
+    }
+    return -1;
+  }
+
+  uint16_t localPort(int fd)
+  {
+    sockaddr_in addr;
+    socklen_t len = sizeof addr;
+    ::getsockname(fd, (sockaddr *)&addr, &len);
+    return ntohs(addr.sin_port);
+  }
+
+  // 两个连接在同一次epoll_wait里都可读，先处理的那个把另一个的数据偷偷读走，
+  // 后处理的那个readfdUntilEagain第一次就EAGAIN、返回0，这不是对端关闭
+  bool spuriousEdge()
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "et_echo_bench", TcpServer::kReusePort);
+    server.setEdgeTriggered(true);
+    int serverFds[2] = {-1, -1};
+    bool stolen = false;
+    int closed = 0;
+    server.setConnectionCallback([&closed](const TcpConnectionPtr &conn)
+                                 {
+      if (!conn->connected())
+      {
+        ++closed;
+      } });
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                              {
+      if (!stolen && serverFds[0] >= 0)
+      {
+        stolen = true;
+        char scratch[64];
+        for (int fd : serverFds)
+        {
+          while (::recv(fd, scratch, sizeof scratch, MSG_DONTWAIT) > 0)
+          {
+          }
+        }
+      }
+      onMessage(conn, buf, Timestamp()); });
+    server.start();
+
+    bool ok = true;
+    std::thread client([&]()
+                       {
+      int fds[2];
+      for (int &fd : fds)
+      {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        InetAddress addr(kPort);
+        if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+        {
+          perror("connect");
+          exit(1);
+        }
+      }
+      char c = 'x';
+      for (int fd : fds)
+      {
+        fullWrite(fd, &c, 1);
+        fullRead(fd, &c, 1);
+      }
+
+      // 先把loop挡住，两个连接的数据都到了之后再放行，保证在同一次epoll_wait里返回
+      std::promise<void> written;
+      std::future<void> release = written.get_future();
+      std::promise<void> blocked;
+      loop.queueInLoop([&]()
+                       {
+        for (int i = 0; i < 2; ++i)
+        {
+          serverFds[i] = findServerFd(localPort(fds[i]));
+        }
+        blocked.set_value();
+        release.wait(); });
+      blocked.get_future().wait();
+      for (int fd : fds)
+      {
+        fullWrite(fd, &c, 1);
+      }
+      written.set_value();
+
+      // 两个连接都还活着：再发一条都能收到回显
+      for (int fd : fds)
+      {
+        fullWrite(fd, &c, 1);
+      }
+      for (int fd : fds)
+      {
+        // 被偷走的那一条没有回显，只等后发的这一条；有回显的连接多出来的一字节也读掉
+        ssize_t n = ::recv(fd, &c, 1, 0);
+        if (n <= 0)
+        {
+          printf("FAIL: connection closed after an edge with no data\n");
+          ok = false;
+        }
+      }
+      // 先半关闭，把剩下的回显读完再关，避免带着未读数据close发RST
+      for (int fd : fds)
+      {
+        ::shutdown(fd, SHUT_WR);
+        while (::read(fd, &c, 1) > 0)
+        {
+        }
+        ::close(fd);
+      }
+      loop.runAfter(0.1, [&loop]()
+                    { loop.quit(); }); });
+
+    loop.loop();
+    client.join();
+    if (!stolen)
+    {
+      printf("FAIL: the two read edges were not delivered together\n");
+      ok = false;
+    }
+    if (closed != 2)
+    {
+      printf("FAIL: %d connections closed, expected 2\n", closed);
+      ok = false;
+    }
+    return ok;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int connections = argc > 1 ? atoi(argv[1]) : 64;
+  int rounds = argc > 2 ? atoi(argv[2]) : 200;
+  Logger::setLogLevel(ERROR);
+
+  printf("%-6s %8s %10s %10s %14s %14s %14s\n", "mode", "size", "msg/s", "MiB/s", "epoll_wait/msg", "epoll_ctl/msg", "ctl saved/msg");
+  const size_t kSizes[] = {64, 4096, 256 * 1024};
+  for (size_t size : kSizes)
+  {
+    // 大消息轮数减少，控制总耗时
+    int n = size > 65536 ? rounds / 10 + 1 : rounds;
+    run(false, size, connections, n);
+    run(true, size, connections, n);
+  }
+  if (!spuriousEdge())
+  {
+    return 1;
+  }
+  printf("edge with no data: ok\n");
+  return 0;
+}
@@ -0,0 +1,294 @@
+// loop运行指标的开销和导出
+//   1. 直方图记录一次的耗时
+//   2. loopback pingpong，对比ioLoop打开和关闭指标时的往返次数
+//   3. 打开TcpServer::enableStats，压测期间从另一个线程抓取 GET /metrics，
+//      检查返回200、包含各项指标且收发字节数和压测的流量一致
+//   4. loop标签很长时render()的每一行仍然完整，失败时返回1
+// 用法: metrics_bench [每种配置的往返次数，默认50000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include "TcpServer.h"
+#include "StatsServer.h"
+#include "LoopMetrics.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9988;
+  const uint16_t kStatsPort = 9987;
+  const size_t kMessageSize = 64;
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  int connectTo(uint16_t port)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(port);
+    if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+    {
+      perror("connect");
+      exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+  }
+
+  void pingpong(int fd, int rounds)
+  {
+    char message[kMessageSize] = {0};
+    char reply[kMessageSize];
+    for (int r = 0; r < rounds; ++r)
+    {
+      if (::write(fd, message, sizeof message) != static_cast<ssize_t>(sizeof message))
+      {
+        perror("write");
+        exit(1);
+      }
+      size_t got = 0;
+      while (got < sizeof reply)
+      {
+        ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+        if (n <= 0)
+        {
+          perror("read");
+          exit(1);
+        }
+        got += n;
+      }
+    }
+  }
+
+  // 发一个请求，读到对端关闭为止
+  std::string scrape(const char *request)
+  {
+    int fd = connectTo(kStatsPort);
+    ::write(fd, request, strlen(request));
+    std::string response;
+    char buf[16384];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+      response.append(buf, n);
+    }
+    ::close(fd);
+    return response;
+  }
+
+  // 某个指标在loop上的值，找不到返回-1
+  double sample(const std::string &text, const std::string &series)
+  {
+    size_t pos = text.find("\n" + series + " ");
+    if (pos == std::string::npos)
+    {
+      return -1;
+    }
+    return atof(text.c_str() + pos + series.size() + 2);
+  }
+
+  void histogramCost()
+  {
+    MetricHistogram histogram;
+    const int kIterations = 10000000;
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < kIterations; ++i)
+    {
+      histogram.record(static_cast<uint64_t>(i) & 1023);
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    MetricHistogram::Snapshot snap;
+    histogram.snapshot(&snap);
+    printf("histogram record: %.2f ns (%lu samples)\n", seconds * 1e9 / kIterations, (unsigned long)snap.count);
+  }
+
+  void overhead(bool enabled, int rounds)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "metrics_bench", TcpServer::kReusePort);
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    // 在ioLoop线程里、loop开始之前调用
+    server.setThreadInitcallback([enabled](EventLoop *ioLoop)
+                                 { ioLoop->setMetricsEnabled(enabled); });
+    server.start();
+
+    std::thread client([&]()
+                       {
+      int fd = connectTo(kPort);
+      Timestamp start(Timestamp::now());
+      pingpong(fd, rounds);
+      double seconds = timeDifference(Timestamp::now(), start);
+      ::close(fd);
+      printf("metrics %-8s %10.0f rtt/s\n", enabled ? "on" : "off", rounds / seconds);
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+  }
+
+  bool endpoint(int rounds)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "echo", TcpServer::kReusePort);
+    server.setThreadNum(2);
+    server.enableStats(InetAddress(kStatsPort));
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    server.start();
+
+    bool ok = true;
+    std::thread client([&]()
+                       {
+      // 两个连接分别落在两个ioLoop上，压测的同时抓取
+      int fds[2] = {connectTo(kPort), connectTo(kPort)};
+      std::thread load0([&]()
+                        { pingpong(fds[0], rounds); });
+      std::thread load1([&]()
+                        { pingpong(fds[1], rounds); });
+      double slowest = 0;
+      int scrapes = 0;
+      std::string text;
+      while (scrapes < 20)
+      {
+        Timestamp start(Timestamp::now());
+        text = scrape("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        slowest = std::max(slowest, timeDifference(Timestamp::now(), start) * 1e6);
+        ++scrapes;
+      }
+      load0.join();
+      load1.join();
+      // 服务端先write再记字节数，客户端收到最后一个回包时计数可能还差一点，等它跟上
+      double expectedBytes = static_cast<double>(rounds) * kMessageSize;
+      for (int i = 0; i < 100; ++i)
+      {
+        text = scrape("GET /metrics HTTP/1.1\r\n\r\n");
+        if (sample(text, "muduo_loop_written_bytes_total{loop=\"echo-0\"}") == expectedBytes &&
+            sample(text, "muduo_loop_written_bytes_total{loop=\"echo-1\"}") == expectedBytes)
+        {
+          break;
+        }
+        ::usleep(1000);
+      }
+      ::close(fds[0]);
+      ::close(fds[1]);
+      printf("scrape: %d requests, slowest %.0f us, %zu bytes\n", scrapes, slowest, text.size());
+
+      if (text.compare(0, 15, "HTTP/1.1 200 OK") != 0)
+      {
+        printf("FAIL: unexpected status line\n");
+        ok = false;
+      }
+      const char *kFamilies[] = {"muduo_loop_iterations_total", "muduo_loop_events_total",
+                                 "muduo_loop_functors_total", "muduo_loop_read_bytes_total",
+                                 "muduo_loop_written_bytes_total", "muduo_loop_connections",
+                                 "muduo_loop_queued_bytes", "muduo_loop_busy_ratio",
+                                 "muduo_loop_events_per_poll", "muduo_loop_functors_per_run",
+                                 "muduo_loop_poll_seconds", "muduo_loop_handler_seconds",
+                                 "muduo_loop_functor_seconds"};
+      for (const char *family : kFamilies)
+      {
+        if (text.find(std::string("# TYPE ") + family + " ") == std::string::npos)
+        {
+          printf("FAIL: %s missing\n", family);
+          ok = false;
+        }
+      }
+      double expected = static_cast<double>(rounds) * kMessageSize;
+      for (int i = 0; i < 2; ++i)
+      {
+        std::string loop = "{loop=\"echo-" + std::to_string(i) + "\"}";
+        double in = sample(text, "muduo_loop_read_bytes_total" + loop);
+        double out = sample(text, "muduo_loop_written_bytes_total" + loop);
+        double iterations = sample(text, "muduo_loop_iterations_total" + loop);
+        double polls = sample(text, "muduo_loop_poll_seconds_count" + loop);
+        printf("echo-%d: read %.0f, written %.0f bytes, %.0f iterations\n", i, in, out, iterations);
+        if (in != expected || out != expected || iterations <= 0 || polls <= 0)
+        {
+          printf("FAIL: expected %.0f bytes each way on echo-%d\n", expected, i);
+          ok = false;
+        }
+      }
+      std::string notFound = scrape("GET / HTTP/1.1\r\n\r\n");
+      if (notFound.compare(0, 22, "HTTP/1.1 404 Not Found") != 0)
+      {
+        printf("FAIL: unknown path was not answered with 404\n");
+        ok = false;
+      }
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+    return ok;
+  }
+
+  // 每一行都以换行结束，样本行是"名字{标签} 数值"，数值能完整解析
+  bool longLabels()
+  {
+    EventLoop loop;
+    StatsServer stats(&loop, InetAddress(kStatsPort), "long");
+    std::string label(300, 'x');
+    stats.addLoop(&loop, label);
+    std::string text = stats.render();
+    bool ok = !text.empty() && text.back() == '\n';
+    int samples = 0;
+    size_t begin = 0;
+    while (ok && begin < text.size())
+    {
+      size_t end = text.find('\n', begin);
+      std::string line(text, begin, end - begin);
+      begin = end + 1;
+      if (line.empty() || line[0] == '#')
+      {
+        continue;
+      }
+      size_t space = line.rfind(' ');
+      char *parsed = nullptr;
+      const char *value = line.c_str() + space + 1;
+      ::strtod(value, &parsed);
+      if (space == std::string::npos || line.find(label) == std::string::npos || parsed == value || *parsed != '\0')
+      {
+        printf("FAIL: malformed line: %.80s...\n", line.c_str());
+        ok = false;
+      }
+      ++samples;
+    }
+    printf("long labels: %d samples, %zu bytes\n", samples, text.size());
+    return ok && samples > 0;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 50000;
+  Logger::setLogLevel(ERROR);
+
+  histogramCost();
+  overhead(false, rounds);
+  overhead(true, rounds);
+  overhead(false, rounds);
+  overhead(true, rounds);
+  if (!endpoint(rounds / 5))
+  {
+    return 1;
+  }
+  printf("stats endpoint: ok\n");
+  if (!longLabels())
+  {
+    return 1;
+  }
+  return 0;
+}
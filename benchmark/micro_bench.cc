@@ -0,0 +1,181 @@
+// 热路径上基础组件的微基准，用Google Benchmark跑，每个组件单独一项，方便对比回归
+//   Buffer的append/retrieve、扩容(makeSpace)，Timestamp::now，CurrentThread::tid，
+//   跨线程queueInLoop的往返，Channel::handleEvent的分发，LOG_*在打开和关闭时的开销
+// 用法: micro_bench [--benchmark_filter=正则] [--benchmark_format=json] 等Google Benchmark的参数
+#include <benchmark/benchmark.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "Buffer.h"
+#include "Timestamp.h"
+#include "CurrentThread.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Channel.h"
+#include "Logger.h"
+
+namespace
+{
+  // append之后全部取走，缓冲区一直复用同一块内存
+  void BM_BufferAppendRetrieve(benchmark::State &state)
+  {
+    const size_t size = static_cast<size_t>(state.range(0));
+    std::string data(size, 'x');
+    Buffer buffer;
+    for (auto _ : state)
+    {
+      buffer.append(data.data(), data.size());
+      benchmark::DoNotOptimize(buffer.peek());
+      buffer.retrieve(size);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+  }
+  BENCHMARK(BM_BufferAppendRetrieve)->Arg(16)->Arg(256)->Arg(4096)->Arg(65536);
+
+  // 每次只取走一半，可读数据往后挪，写满时由makeSpace把数据挪回前面
+  void BM_BufferPartialRetrieve(benchmark::State &state)
+  {
+    const size_t size = static_cast<size_t>(state.range(0));
+    std::string data(size, 'x');
+    Buffer buffer;
+    for (auto _ : state)
+    {
+      buffer.append(data.data(), data.size());
+      buffer.retrieve(buffer.readableBytes() > size ? size : size / 2);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+  }
+  BENCHMARK(BM_BufferPartialRetrieve)->Arg(16)->Arg(256)->Arg(4096);
+
+  // 新的Buffer从空开始写到指定大小，包含第一次分配和之后的每次扩容
+  void BM_BufferGrow(benchmark::State &state)
+  {
+    const size_t size = static_cast<size_t>(state.range(0));
+    std::string chunk(512, 'x');
+    for (auto _ : state)
+    {
+      Buffer buffer;
+      for (size_t n = 0; n < size; n += chunk.size())
+      {
+        buffer.append(chunk.data(), chunk.size());
+      }
+      benchmark::DoNotOptimize(buffer.peek());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+  }
+  BENCHMARK(BM_BufferGrow)->Arg(4096)->Arg(65536)->Arg(1 << 20);
+
+  void BM_TimestampNow(benchmark::State &state)
+  {
+    for (auto _ : state)
+    {
+      benchmark::DoNotOptimize(Timestamp::now());
+    }
+  }
+  BENCHMARK(BM_TimestampNow);
+
+  void BM_CurrentThreadTid(benchmark::State &state)
+  {
+    for (auto _ : state)
+    {
+      benchmark::DoNotOptimize(CurrentThread::tid());
+    }
+  }
+  BENCHMARK(BM_CurrentThreadTid);
+
+  // 从本线程queueInLoop到另一个ioLoop，等它执行完，包括唤醒的开销
+  void BM_QueueInLoopRoundTrip(benchmark::State &state)
+  {
+    EventLoopThread thread(EventLoopThread::ThreadInitCallback(), "micro_bench");
+    EventLoop *loop = thread.startLoop();
+    std::atomic<bool> done(false);
+    for (auto _ : state)
+    {
+      done.store(false, std::memory_order_relaxed);
+      loop->queueInLoop([&done]()
+                        { done.store(true, std::memory_order_release); });
+      while (!done.load(std::memory_order_acquire))
+      {
+      }
+    }
+  }
+  BENCHMARK(BM_QueueInLoopRoundTrip)->UseRealTime();
+
+  // 可读事件分发到读回调，参数为1时和TcpConnection一样tie住一个对象
+  void BM_ChannelHandleEvent(benchmark::State &state)
+  {
+    EventLoop loop;
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int64_t reads = 0;
+    {
+      // 不加入poller，只测分发本身
+      Channel channel(&loop, fd);
+      std::shared_ptr<int> owner(new int(0));
+      if (state.range(0))
+      {
+        channel.tie(owner);
+      }
+      channel.setReadCallback([&reads](Timestamp)
+                              { ++reads; });
+      channel.set_revents(EPOLLIN);
+      Timestamp now(Timestamp::now());
+      for (auto _ : state)
+      {
+        channel.handleEvent(now);
+      }
+    }
+    ::close(fd);
+    benchmark::DoNotOptimize(reads);
+  }
+  BENCHMARK(BM_ChannelHandleEvent)->ArgName("tied")->Arg(0)->Arg(1);
+
+  void discardOutput(const char *, int)
+  {
+  }
+
+  // 参数为1时级别打开，格式化之后交给一个丢弃一切的输出端；为0时只有级别判断
+  void BM_LogInfo(benchmark::State &state)
+  {
+    Logger::setOutput(discardOutput);
+    Logger::setLogLevel(state.range(0) ? INFO : ERROR);
+    int fd = 42;
+    for (auto _ : state)
+    {
+      LOG_INFO("fd = %d bytes = %zu \n", fd, static_cast<size_t>(state.iterations()));
+    }
+    Logger::setLogLevel(ERROR);
+  }
+  BENCHMARK(BM_LogInfo)->ArgName("enabled")->Arg(0)->Arg(1);
+
+  void BM_LogStream(benchmark::State &state)
+  {
+    Logger::setOutput(discardOutput);
+    Logger::setLogLevel(state.range(0) ? INFO : ERROR);
+    int fd = 42;
+    for (auto _ : state)
+    {
+      LOG_STREAM(INFO) << "fd = " << fd << " revents = " << 1;
+    }
+    Logger::setLogLevel(ERROR);
+  }
+  BENCHMARK(BM_LogStream)->ArgName("enabled")->Arg(0)->Arg(1);
+}
+
+int main(int argc, char **argv)
+{
+  // ioLoop线程启动和退出时的INFO日志不要混进结果
+  Logger::setLogLevel(ERROR);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+  {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,202 @@
+// pingpong吞吐量，走loopback，服务端和客户端在同一个进程里各用一组ioLoop
+// 客户端用TcpClient建立若干连接，连上后发一个消息，之后双方收到什么就原样发回去，
+// 所有连接都建立之后开始计时，统计客户端收到的字节数和消息数；结果以JSON输出到标准输出
+// 用法: pingpong_bench [-c 连接数，默认100] [-t 服务端和客户端各自的ioLoop数，默认1]
+//                      [-s 消息字节数，默认4096] [-d 测量秒数，默认5]
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9985;
+
+  struct Options
+  {
+    int connections = 100;
+    int threads = 1;
+    size_t messageSize = 4096;
+    double seconds = 5;
+  };
+
+  void onServerMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  // 一个客户端连接，计数只有所在的loop线程写，baseLoop在开始和结束时读
+  struct Session
+  {
+    std::unique_ptr<TcpClient> client;
+    std::atomic<uint64_t> bytesRead{0};
+  };
+
+  class Client
+  {
+  public:
+    Client(EventLoop *loop, const Options &options)
+        : loop_(loop),
+          options_(options),
+          pool_(loop, "pingpong_client"),
+          message_(options.messageSize, 'x'),
+          connected_(0),
+          disconnected_(0),
+          startBytes_(0)
+    {
+      pool_.setThreadNum(options.threads);
+      pool_.start();
+      for (int i = 0; i < options.connections; ++i)
+      {
+        std::unique_ptr<Session> session(new Session);
+        char name[32];
+        snprintf(name, sizeof name, "client%d", i);
+        session->client.reset(new TcpClient(pool_.getNextLoop(), InetAddress(kPort), name));
+        Session *s = session.get();
+        session->client->setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                               { onConnection(conn); });
+        session->client->setMessageCallback([s](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                                            {
+          s->bytesRead.store(s->bytesRead.load(std::memory_order_relaxed) + buf->readableBytes(),
+                             std::memory_order_relaxed);
+          conn->send(buf->peek(), buf->readableBytes());
+          buf->retrieveAll(); });
+        sessions_.push_back(std::move(session));
+      }
+      for (auto &session : sessions_)
+      {
+        session->client->connect();
+      }
+    }
+
+    uint64_t bytesRead() const
+    {
+      uint64_t total = 0;
+      for (const auto &session : sessions_)
+      {
+        total += session->bytesRead.load(std::memory_order_relaxed);
+      }
+      return total;
+    }
+
+    // 以下在baseLoop线程里执行
+    void stop()
+    {
+      stopTime_ = Timestamp::now();
+      stopBytes_ = bytesRead();
+      for (auto &session : sessions_)
+      {
+        session->client->disconnect();
+      }
+    }
+
+    Timestamp startTime() const { return startTime_; }
+    Timestamp stopTime() const { return stopTime_; }
+    uint64_t measuredBytes() const { return stopBytes_ - startBytes_; }
+
+  private:
+    // 在各个客户端的loop线程里调用
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+      if (conn->connected())
+      {
+        conn->setTcpNoDelay(true);
+        conn->send(message_);
+        if (++connected_ == options_.connections)
+        {
+          loop_->runInLoop([this]()
+                           {
+            startTime_ = Timestamp::now();
+            startBytes_ = bytesRead();
+            loop_->runAfter(options_.seconds, [this]()
+                            { stop(); }); });
+        }
+      }
+      else if (++disconnected_ == options_.connections)
+      {
+        loop_->quit();
+      }
+    }
+
+    EventLoop *loop_;
+    const Options options_;
+    EventLoopThreadPool pool_;
+    const std::string message_;
+    std::vector<std::unique_ptr<Session>> sessions_;
+    std::atomic<int> connected_;
+    std::atomic<int> disconnected_;
+    Timestamp startTime_;
+    Timestamp stopTime_;
+    uint64_t startBytes_;
+    uint64_t stopBytes_;
+  };
+}
+
+int main(int argc, char *argv[])
+{
+  Options options;
+  int opt;
+  while ((opt = ::getopt(argc, argv, "c:t:s:d:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'c':
+      options.connections = atoi(optarg);
+      break;
+    case 't':
+      options.threads = atoi(optarg);
+      break;
+    case 's':
+      options.messageSize = static_cast<size_t>(atol(optarg));
+      break;
+    case 'd':
+      options.seconds = atof(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-c connections] [-t threads] [-s message_size] [-d seconds]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (options.connections <= 0 || options.threads < 0 || options.messageSize == 0 || options.seconds <= 0)
+  {
+    fprintf(stderr, "invalid arguments\n");
+    return 2;
+  }
+  Logger::setLogLevel(ERROR);
+
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort), "pingpong_server", TcpServer::kReusePort);
+  server.setThreadNum(options.threads);
+  server.setConnectionCallback([](const TcpConnectionPtr &conn)
+                               {
+    if (conn->connected())
+    {
+      conn->setTcpNoDelay(true);
+    } });
+  server.setMessageCallback(onServerMessage);
+  server.start();
+
+  std::unique_ptr<Client> client(new Client(&loop, options));
+  loop.loop();
+
+  double seconds = timeDifference(client->stopTime(), client->startTime());
+  uint64_t bytes = client->measuredBytes();
+  double messages = static_cast<double>(bytes) / options.messageSize;
+  printf("{\"benchmark\":\"pingpong\",\"connections\":%d,\"threads\":%d,\"message_size\":%zu,"
+         "\"seconds\":%.3f,\"bytes\":%llu,\"messages\":%.0f,\"mib_per_second\":%.2f,\"messages_per_second\":%.0f}\n",
+         options.connections, options.threads, options.messageSize, seconds,
+         static_cast<unsigned long long>(bytes), messages,
+         bytes / seconds / (1024 * 1024), messages / seconds);
+  client.reset();
+  return 0;
+}
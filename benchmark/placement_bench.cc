@@ -0,0 +1,267 @@
+// 新连接分配策略的对比，4个ioLoop
+//   1. 选择开销：在baseLoop线程里反复调用getLoopForConnection，每次的耗时
+//   2. 长短连接混合：每4个连接里有1个长连接(发一个'H'后一直保持)，其余建立后立刻关闭，
+//      轮询会把长连接全部分到同一个loop上，统计各个loop上长连接的个数
+//   3. 一致性哈希：客户端从127.0.0.1~127.0.0.16发起连接，检查同一个IP总是落在同一个loop上，
+//      不满足时返回1
+// 用法: placement_bench [长短混合的连接数，默认400]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9997;
+  const int kLoops = 4;
+
+  struct Policy
+  {
+    const char *name;
+    EventLoopThreadPool::Placement placement;
+    EventLoopThreadPool::LoadSignal signal;
+  };
+
+  const Policy kPolicies[] = {
+      {"round-robin", EventLoopThreadPool::kRoundRobin, EventLoopThreadPool::kActiveConnections},
+      {"least-conn", EventLoopThreadPool::kLeastConnections, EventLoopThreadPool::kActiveConnections},
+      {"p2c-conn", EventLoopThreadPool::kPowerOfTwoChoices, EventLoopThreadPool::kActiveConnections},
+      {"p2c-bytes", EventLoopThreadPool::kPowerOfTwoChoices, EventLoopThreadPool::kQueuedBytes},
+      {"p2c-busy", EventLoopThreadPool::kPowerOfTwoChoices, EventLoopThreadPool::kBusyRatio},
+      {"hash", EventLoopThreadPool::kConsistentHash, EventLoopThreadPool::kActiveConnections},
+  };
+
+  std::vector<EventLoop *> g_loops;
+  std::atomic<int> g_closed(0);
+  std::atomic<int> g_heavy[kLoops];
+  // 一致性哈希检查：对端IP -> 落到的loop集合
+  std::mutex g_mutex;
+  std::map<std::string, std::vector<int>> g_ipLoops;
+
+  int loopIndex(EventLoop *loop)
+  {
+    for (size_t i = 0; i < g_loops.size(); ++i)
+    {
+      if (g_loops[i] == loop)
+      {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  void onConnection(const TcpConnectionPtr &conn)
+  {
+    if (conn->connected())
+    {
+      std::lock_guard<std::mutex> lock(g_mutex);
+      std::vector<int> &loops = g_ipLoops[conn->peerAddress().toIp()];
+      int index = loopIndex(conn->getLoop());
+      if (std::find(loops.begin(), loops.end(), index) == loops.end())
+      {
+        loops.push_back(index);
+      }
+    }
+    else
+    {
+      ++g_closed;
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    if (buf->readableBytes() > 0 && *buf->peek() == 'H')
+    {
+      ++g_heavy[loopIndex(conn->getLoop())];
+    }
+    buf->retrieveAll();
+  }
+
+  int connectFrom(const char *sourceIp)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (sourceIp != nullptr)
+    {
+      InetAddress source(0, sourceIp);
+      if (::bind(fd, (sockaddr *)source.getSockAddr(), sizeof(sockaddr_in)) < 0)
+      {
+        perror("bind");
+        exit(1);
+      }
+    }
+    InetAddress addr(kPort);
+    if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+    {
+      perror("connect");
+      exit(1);
+    }
+    return fd;
+  }
+
+  void closeReset(int fd)
+  {
+    struct linger lin = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+    ::close(fd);
+  }
+
+  void waitClosed(int n)
+  {
+    while (g_closed.load() < n)
+    {
+      ::usleep(100);
+    }
+  }
+
+  // 返回false表示一致性哈希检查失败
+  bool run(const Policy &policy, int connections)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "placement_bench", TcpServer::kReusePort);
+    server.setThreadNum(kLoops);
+    server.setPlacement(policy.placement, policy.signal);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    g_loops.clear();
+    server.setThreadInitcallback([](EventLoop *ioLoop)
+                                 { g_loops.push_back(ioLoop); });
+    g_closed = 0;
+    for (int i = 0; i < kLoops; ++i)
+    {
+      g_heavy[i] = 0;
+    }
+    g_ipLoops.clear();
+    server.start();
+
+    bool ok = true;
+    std::thread client([&]()
+                       {
+      std::vector<int> heavy;
+      int closed = 0;
+      int heavyCount = 0;
+      for (int i = 0; i < connections; ++i)
+      {
+        int fd = connectFrom(nullptr);
+        if (i % 4 == 0)
+        {
+          ::write(fd, "H", 1);
+          heavy.push_back(fd);
+          ++heavyCount;
+          while (g_heavy[0] + g_heavy[1] + g_heavy[2] + g_heavy[3] < heavyCount)
+          {
+            ::usleep(100);
+          }
+        }
+        else
+        {
+          closeReset(fd);
+          waitClosed(++closed);
+        }
+      }
+      int minHeavy = heavyCount;
+      int maxHeavy = 0;
+      char perLoop[64] = {0};
+      for (int i = 0; i < kLoops; ++i)
+      {
+        minHeavy = std::min(minHeavy, g_heavy[i].load());
+        maxHeavy = std::max(maxHeavy, g_heavy[i].load());
+        snprintf(perLoop + strlen(perLoop), sizeof perLoop - strlen(perLoop), "%s%d", i ? "/" : "", g_heavy[i].load());
+      }
+      for (int fd : heavy)
+      {
+        closeReset(fd);
+      }
+      waitClosed(closed + heavyCount);
+
+      // 每个IP连4次，看是否总落在同一个loop上
+      const int kIps = 16;
+      {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_ipLoops.clear();
+      }
+      std::vector<int> fds;
+      for (int round = 0; round < 4; ++round)
+      {
+        for (int i = 1; i <= kIps; ++i)
+        {
+          char ip[32];
+          snprintf(ip, sizeof ip, "127.0.0.%d", i);
+          fds.push_back(connectFrom(ip));
+        }
+      }
+      for (int fd : fds)
+      {
+        closeReset(fd);
+      }
+      waitClosed(closed + heavyCount + static_cast<int>(fds.size()));
+      int sticky = 0;
+      {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (const auto &item : g_ipLoops)
+        {
+          sticky += item.second.size() == 1;
+        }
+      }
+      printf("%-12s %12s %6d %6d %12d/%d\n", policy.name, perLoop, minHeavy, maxHeavy, sticky, kIps);
+      if (policy.placement == EventLoopThreadPool::kConsistentHash && sticky != kIps)
+      {
+        printf("FAIL: consistent hash did not keep every peer IP on one loop\n");
+        ok = false;
+      }
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+    return ok;
+  }
+
+  void selectionCost()
+  {
+    EventLoop loop;
+    InetAddress peer(12345, "10.0.0.1");
+    printf("%-12s %12s\n", "policy", "ns/select");
+    for (const Policy &policy : kPolicies)
+    {
+      EventLoopThreadPool pool(&loop, "placement_bench");
+      pool.setThreadNum(kLoops);
+      pool.setPlacement(policy.placement, policy.signal);
+      pool.start();
+      const int kIterations = 1000000;
+      Timestamp start(Timestamp::now());
+      for (int i = 0; i < kIterations; ++i)
+      {
+        pool.getLoopForConnection(peer);
+      }
+      double seconds = timeDifference(Timestamp::now(), start);
+      printf("%-12s %12.1f\n", policy.name, seconds * 1e9 / kIterations);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int connections = argc > 1 ? atoi(argv[1]) : 400;
+  // 客户端用RST断开，服务端每个连接都会打一条handleError日志，这里不关心
+  Logger::setLogLevel(FATAL);
+
+  selectionCost();
+
+  printf("\n%-12s %12s %6s %6s %14s\n", "policy", "heavy/loop", "min", "max", "sticky IPs");
+  bool ok = true;
+  for (const Policy &policy : kPolicies)
+  {
+    ok = run(policy, connections) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+// epoll和io_uring两种Poller的对比，走loopback echo
+// 服务端在主线程的loop上，客户端线程开若干连接，每轮在所有连接上各发一条消息再全部收回来，
+// 记录每一轮的耗时作为延迟；连接数为1时就是单连接的往返延迟
+// 同时统计服务端poller每条消息的系统调用次数(epoll_wait+epoll_ctl 或 io_uring_enter)
+// 用法: poller_bench [每种配置的轮数，默认2000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+#include "IoUringPoller.h"
+
+namespace
+{
+  const uint16_t kPort = 9993;
+
+  struct Counters
+  {
+    uint64_t polls;
+    uint64_t ctls;
+  };
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  Counters snapshot(EventLoop *loop)
+  {
+    std::promise<Counters> promise;
+    std::future<Counters> future = promise.get_future();
+    loop->queueInLoop([loop, &promise]()
+                      { promise.set_value(Counters{loop->pollCalls(), loop->pollerCtlCalls()}); });
+    return future.get();
+  }
+
+  void fullWrite(int fd, const char *data, size_t len)
+  {
+    while (len > 0)
+    {
+      ssize_t n = ::write(fd, data, len);
+      if (n <= 0)
+      {
+        perror("write");
+        exit(1);
+      }
+      data += n;
+      len -= n;
+    }
+  }
+
+  void fullRead(int fd, char *data, size_t len)
+  {
+    while (len > 0)
+    {
+      ssize_t n = ::read(fd, data, len);
+      if (n <= 0)
+      {
+        perror("read");
+        exit(1);
+      }
+      data += n;
+      len -= n;
+    }
+  }
+
+  void run(const char *backend, bool edgeTriggered, int connections, size_t messageSize, int rounds)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "poller_bench", TcpServer::kReusePort);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    server.start();
+
+    std::thread client([&]()
+                       {
+      std::vector<int> fds;
+      for (int i = 0; i < connections; ++i)
+      {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        InetAddress addr(kPort);
+        if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+        {
+          perror("connect");
+          exit(1);
+        }
+        fds.push_back(fd);
+      }
+      std::vector<char> message(messageSize, 'x');
+      std::vector<char> reply(messageSize);
+      fullWrite(fds.back(), message.data(), 1);
+      fullRead(fds.back(), reply.data(), 1);
+
+      std::vector<double> latencies;
+      latencies.reserve(rounds);
+      Counters before = snapshot(&loop);
+      Timestamp start(Timestamp::now());
+      for (int r = 0; r < rounds; ++r)
+      {
+        Timestamp roundStart(Timestamp::now());
+        for (int fd : fds)
+        {
+          fullWrite(fd, message.data(), message.size());
+        }
+        for (int fd : fds)
+        {
+          fullRead(fd, reply.data(), reply.size());
+        }
+        latencies.push_back(timeDifference(Timestamp::now(), roundStart) * 1e6);
+      }
+      double seconds = timeDifference(Timestamp::now(), start);
+      Counters after = snapshot(&loop);
+
+      std::sort(latencies.begin(), latencies.end());
+      double sum = 0;
+      for (double l : latencies)
+      {
+        sum += l;
+      }
+      double messages = static_cast<double>(connections) * rounds;
+      printf("%-8s %-3s %5d %6zu %10.0f %10.1f %10.1f %12.3f\n",
+             backend, edgeTriggered ? "ET" : "LT", connections, messageSize,
+             messages / seconds, sum / latencies.size(),
+             latencies[latencies.size() * 99 / 100],
+             (after.polls - before.polls + after.ctls - before.ctls) / messages);
+      for (int fd : fds)
+      {
+        ::close(fd);
+      }
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+  Logger::setLogLevel(ERROR);
+
+  bool uring = IoUringPoller::supported();
+  if (!uring)
+  {
+    printf("io_uring is not supported by this kernel, only epoll is measured\n");
+  }
+  printf("%-8s %-3s %5s %6s %10s %10s %10s %12s\n",
+         "backend", "", "conns", "size", "msg/s", "avg us", "p99 us", "syscalls/msg");
+
+  struct Config
+  {
+    int connections;
+    size_t messageSize;
+  };
+  const Config kConfigs[] = {{1, 64}, {64, 64}, {64, 4096}};
+  const char *backends[] = {"epoll", "io_uring"};
+  for (const Config &config : kConfigs)
+  {
+    for (const char *backend : backends)
+    {
+      bool isUring = backend[0] == 'i';
+      if (isUring && !uring)
+      {
+        continue;
+      }
+      // newDefaultPoller按环境变量选择实现
+      if (isUring)
+      {
+        ::setenv("MUDUO_USE_IO_URING", "1", 1);
+      }
+      else
+      {
+        ::unsetenv("MUDUO_USE_IO_URING");
+      }
+      int n = config.connections > 1 ? rounds / 10 + 1 : rounds;
+      run(backend, false, config.connections, config.messageSize, n);
+      run(backend, true, config.connections, config.messageSize, n);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,412 @@
+// 所有Poller实现都要通过的一致性检查，外加fd数量的扩展性测试
+// 每个后端(epoll/poll/io_uring)各建一个EventLoop，通过Channel驱动，检查：
+//   add/modify/remove、水平触发的重复通知、对端关闭(HUP)、连接出错(ERR)、
+//   fd被close后复用、边沿触发channel空闲时不空转；
+//   io_uring另外检查poll请求以错误结束时channel能收到错误，而不是再也没有事件
+// 然后注册N个fd，测量注册、只有一个fd活跃时单次poll、注销的耗时
+// 有检查失败时返回1
+// 用法: poller_conformance [扩展性测试的fd数，默认10000]
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EventLoop.h"
+#include "Channel.h"
+#include "InetAddress.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
+
+namespace
+{
+  int g_failures = 0;
+
+  void check(const char *backend, const char *name, bool ok, const std::string &detail = std::string())
+  {
+    printf("[%-8s] %-36s %s %s\n", backend, name, ok ? "ok" : "FAILED", detail.c_str());
+    if (!ok)
+    {
+      ++g_failures;
+    }
+  }
+
+  // 让loop跑ms毫秒
+  void runFor(EventLoop *loop, int ms)
+  {
+    loop->runAfter(ms / 1000.0, [loop]()
+                   { loop->quit(); });
+    loop->loop();
+  }
+
+  struct SocketPair
+  {
+    int fds[2];
+    SocketPair()
+    {
+      if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+      {
+        perror("socketpair");
+        exit(1);
+      }
+    }
+    ~SocketPair()
+    {
+      closeEnd(0);
+      closeEnd(1);
+    }
+    void closeEnd(int i)
+    {
+      if (fds[i] >= 0)
+      {
+        ::close(fds[i]);
+        fds[i] = -1;
+      }
+    }
+  };
+
+  // 记录channel上每种回调的次数
+  struct Probe
+  {
+    int reads = 0;
+    int writes = 0;
+    int closes = 0;
+    int errors = 0;
+    bool drain = true; // 读回调里是否把数据读走
+    bool eof = false;
+
+    void attach(Channel *channel)
+    {
+      int fd = channel->fd();
+      channel->setReadCallback([this, fd](Timestamp)
+                               {
+        ++reads;
+        if (drain)
+        {
+          char buf[4096];
+          ssize_t n;
+          while ((n = ::read(fd, buf, sizeof buf)) > 0)
+          {
+          }
+          if (n == 0)
+          {
+            eof = true;
+          }
+        } });
+      channel->setWriteCallback([this]()
+                                { ++writes; });
+      channel->setCloseCallback([this]()
+                                { ++closes; });
+      channel->setErrorCallback([this]()
+                                { ++errors; });
+    }
+  };
+
+  void removeChannel(Channel *channel)
+  {
+    channel->disableAll();
+    channel->remove();
+  }
+
+  void testReadable(const char *backend, EventLoop *loop)
+  {
+    SocketPair sp;
+    Channel channel(loop, sp.fds[0]);
+    Probe probe;
+    probe.attach(&channel);
+    channel.enableReading();
+    check(backend, "add registers channel", loop->hasChannel(&channel));
+
+    runFor(loop, 20);
+    check(backend, "no event before data", probe.reads == 0);
+
+    ssize_t n = ::write(sp.fds[1], "x", 1);
+    (void)n;
+    runFor(loop, 20);
+    check(backend, "readable after write", probe.reads == 1, "reads=" + std::to_string(probe.reads));
+    removeChannel(&channel);
+    check(backend, "remove unregisters channel", !loop->hasChannel(&channel));
+  }
+
+  void testLevelTriggered(const char *backend, EventLoop *loop)
+  {
+    SocketPair sp;
+    Channel channel(loop, sp.fds[0]);
+    Probe probe;
+    probe.drain = false;
+    probe.attach(&channel);
+    channel.enableReading();
+    ssize_t n = ::write(sp.fds[1], "x", 1);
+    (void)n;
+    // 数据一直没读走，每一轮都应该再通知一次
+    TimerId ticker = loop->runEvery(0.005, []() {});
+    runFor(loop, 50);
+    loop->cancel(ticker);
+    check(backend, "level-triggered repeats unread data", probe.reads >= 2, "reads=" + std::to_string(probe.reads));
+    removeChannel(&channel);
+  }
+
+  void testModify(const char *backend, EventLoop *loop)
+  {
+    SocketPair sp;
+    Channel channel(loop, sp.fds[0]);
+    Probe probe;
+    probe.attach(&channel);
+    channel.enableReading();
+    channel.enableWriting();
+    runFor(loop, 20);
+    check(backend, "enableWriting reports writable", probe.writes >= 1, "writes=" + std::to_string(probe.writes));
+
+    channel.disableWriting();
+    probe.writes = 0;
+    runFor(loop, 20);
+    check(backend, "disableWriting stops writable", probe.writes == 0, "writes=" + std::to_string(probe.writes));
+
+    channel.disableReading();
+    ssize_t n = ::write(sp.fds[1], "x", 1);
+    (void)n;
+    runFor(loop, 20);
+    check(backend, "disableReading stops readable", probe.reads == 0, "reads=" + std::to_string(probe.reads));
+
+    channel.enableReading();
+    runFor(loop, 20);
+    check(backend, "re-enable delivers pending data", probe.reads == 1, "reads=" + std::to_string(probe.reads));
+    removeChannel(&channel);
+  }
+
+  void testRemove(const char *backend, EventLoop *loop)
+  {
+    SocketPair sp;
+    Channel channel(loop, sp.fds[0]);
+    Probe probe;
+    probe.attach(&channel);
+    channel.enableReading();
+    removeChannel(&channel);
+    ssize_t n = ::write(sp.fds[1], "x", 1);
+    (void)n;
+    runFor(loop, 20);
+    check(backend, "removed channel gets no events", probe.reads == 0, "reads=" + std::to_string(probe.reads));
+  }
+
+  void testHangup(const char *backend, EventLoop *loop)
+  {
+    SocketPair sp;
+    Channel channel(loop, sp.fds[0]);
+    Probe probe;
+    probe.attach(&channel);
+    channel.enableReading();
+    sp.closeEnd(1);
+    runFor(loop, 20);
+    // 对端关闭：EPOLLIN|EPOLLHUP走读回调读到0，或者只有HUP走关闭回调
+    check(backend, "peer close is reported", probe.eof || probe.closes > 0,
+          "reads=" + std::to_string(probe.reads) + " closes=" + std::to_string(probe.closes));
+    removeChannel(&channel);
+  }
+
+  void testError(const char *backend, EventLoop *loop)
+  {
+    // 找一个没人监听的端口：绑定之后不listen就关掉
+    int probeFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress any(0, "127.0.0.1");
+    ::bind(probeFd, (sockaddr *)any.getSockAddr(), sizeof(sockaddr_in));
+    sockaddr_in bound;
+    socklen_t len = sizeof bound;
+    ::getsockname(probeFd, (sockaddr *)&bound, &len);
+    ::close(probeFd);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int ret = ::connect(fd, (sockaddr *)&bound, sizeof bound);
+    if (ret == 0 || errno != EINPROGRESS)
+    {
+      check(backend, "connect error is reported", errno == ECONNREFUSED, "refused synchronously");
+      ::close(fd);
+      return;
+    }
+    Channel channel(loop, fd);
+    Probe probe;
+    probe.attach(&channel);
+    channel.enableWriting();
+    runFor(loop, 50);
+    check(backend, "connect error is reported", probe.errors > 0,
+          "errors=" + std::to_string(probe.errors) + " closes=" + std::to_string(probe.closes));
+    removeChannel(&channel);
+    ::close(fd);
+  }
+
+  void testFdReuse(const char *backend, EventLoop *loop)
+  {
+    std::unique_ptr<SocketPair> first(new SocketPair);
+    int fd = first->fds[0];
+    Probe oldProbe;
+    {
+      Channel channel(loop, fd);
+      oldProbe.attach(&channel);
+      channel.enableReading();
+      runFor(loop, 5);
+      removeChannel(&channel);
+    }
+    first.reset();
+
+    SocketPair second; // 通常会拿到同一个fd
+    Channel channel(loop, second.fds[0]);
+    Probe probe;
+    probe.attach(&channel);
+    channel.enableReading();
+    ssize_t n = ::write(second.fds[1], "x", 1);
+    (void)n;
+    runFor(loop, 20);
+    check(backend, "reused fd delivers to new channel", probe.reads == 1 && oldProbe.reads == 0,
+          std::string(second.fds[0] == fd ? "same fd" : "different fd") + " reads=" + std::to_string(probe.reads));
+    removeChannel(&channel);
+  }
+
+  void testEdgeTriggeredIdle(const char *backend, EventLoop *loop)
+  {
+    SocketPair sp;
+    Channel channel(loop, sp.fds[0]);
+    Probe probe;
+    probe.attach(&channel);
+    channel.setEdgeTriggered(true);
+    channel.enableReading();
+    runFor(loop, 5);
+    // socket一直可写，但没有待发数据时loop应该阻塞而不是空转
+    uint64_t polls = loop->pollCalls();
+    runFor(loop, 100);
+    uint64_t spins = loop->pollCalls() - polls;
+    check(backend, "edge-triggered idle does not spin", spins < 10, "polls=" + std::to_string(spins));
+
+    ssize_t n = ::write(sp.fds[1], "x", 1);
+    (void)n;
+    runFor(loop, 20);
+    check(backend, "edge-triggered readable", probe.reads >= 1, "reads=" + std::to_string(probe.reads));
+    removeChannel(&channel);
+  }
+
+  // 只对io_uring：对一个没有打开的fd提交poll，完成事件的res是-EBADF，
+  // poller重试一次之后应该把它当作EPOLLERR交给channel，而且不会一直重试
+  void testPollFailure(const char *backend, EventLoop *loop)
+  {
+    int fd = 1000;
+    while (::fcntl(fd, F_GETFD) >= 0)
+    {
+      ++fd;
+    }
+    Channel channel(loop, fd);
+    Probe probe;
+    probe.attach(&channel);
+    channel.enableReading();
+    runFor(loop, 50);
+    check(backend, "failed poll is reported as error", probe.errors >= 1 && probe.errors < 10,
+          "errors=" + std::to_string(probe.errors) + " reads=" + std::to_string(probe.reads));
+    removeChannel(&channel);
+  }
+
+  void scaling(const char *backend, EventLoop *loop, int numFds)
+  {
+    int pairs = numFds / 2;
+    std::vector<std::unique_ptr<SocketPair>> sockets;
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::vector<Probe> probes(pairs);
+    for (int i = 0; i < pairs; ++i)
+    {
+      sockets.emplace_back(new SocketPair);
+    }
+
+    // 两端都注册，一共numFds个fd
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < pairs; ++i)
+    {
+      for (int end = 0; end < 2; ++end)
+      {
+        channels.emplace_back(new Channel(loop, sockets[i]->fds[end]));
+        probes[i].attach(channels.back().get());
+        channels.back()->enableReading();
+      }
+    }
+    double addUs = timeDifference(Timestamp::now(), start) * 1e6 / channels.size();
+
+    // 每轮只有一个fd活跃，测一次poll+分发的耗时
+    const int kRounds = 200;
+    runFor(loop, 1);
+    uint64_t polls = loop->pollCalls();
+    start = Timestamp::now();
+    for (int r = 0; r < kRounds; ++r)
+    {
+      ssize_t n = ::write(sockets[r % pairs]->fds[1], "x", 1);
+      (void)n;
+      loop->queueInLoop([loop]()
+                        { loop->quit(); });
+      loop->loop();
+    }
+    double pollUs = timeDifference(Timestamp::now(), start) * 1e6 / (loop->pollCalls() - polls);
+
+    start = Timestamp::now();
+    for (std::unique_ptr<Channel> &channel : channels)
+    {
+      removeChannel(channel.get());
+    }
+    double removeUs = timeDifference(Timestamp::now(), start) * 1e6 / channels.size();
+    printf("[%-8s] %d fds: add %.2f us/fd, poll with 1 active %.1f us, remove %.2f us/fd\n",
+           backend, static_cast<int>(channels.size()), addUs, pollUs, removeUs);
+  }
+
+  void runBackend(const char *backend, int numFds)
+  {
+    EventLoop loop;
+    testReadable(backend, &loop);
+    testLevelTriggered(backend, &loop);
+    testModify(backend, &loop);
+    testRemove(backend, &loop);
+    testHangup(backend, &loop);
+    testError(backend, &loop);
+    testFdReuse(backend, &loop);
+    testEdgeTriggeredIdle(backend, &loop);
+    if (std::string(backend) == "io_uring")
+    {
+      testPollFailure(backend, &loop);
+    }
+    const int kSizes[] = {16, 128, 1024};
+    for (int n : kSizes)
+    {
+      if (n < numFds)
+      {
+        scaling(backend, &loop, n);
+      }
+    }
+    scaling(backend, &loop, numFds);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int numFds = argc > 1 ? atoi(argv[1]) : 10000;
+  Logger::setLogLevel(ERROR);
+
+  // newDefaultPoller按环境变量选择实现
+  ::unsetenv("MUDUO_USE_POLL");
+  ::unsetenv("MUDUO_USE_IO_URING");
+  runBackend("epoll", numFds);
+
+  ::setenv("MUDUO_USE_POLL", "1", 1);
+  runBackend("poll", numFds);
+  ::unsetenv("MUDUO_USE_POLL");
+
+  if (IoUringPoller::supported())
+  {
+    ::setenv("MUDUO_USE_IO_URING", "1", 1);
+    runBackend("io_uring", numFds);
+    ::unsetenv("MUDUO_USE_IO_URING");
+  }
+  else
+  {
+    printf("[io_uring] not supported by this kernel, skipped\n");
+  }
+
+  printf("%s\n", g_failures == 0 ? "all backends passed" : "FAILED");
+  return g_failures == 0 ? 0 : 1;
+}
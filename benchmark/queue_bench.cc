@@ -0,0 +1,157 @@
+// 跨线程投递任务的吞吐：N个生产者线程同时向一个EventLoop queueInLoop
+// 对照组是原来的做法：mutex + vector，每次入队都写一次eventfd
+// 用法: queue_bench [每轮任务总数，默认1000000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Timestamp.h"
+
+namespace
+{
+  std::atomic<int64_t> g_done(0);
+
+  void waitDone(int64_t total)
+  {
+    while (g_done.load(std::memory_order_acquire) < total)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  // 原来EventLoop::queueInLoop/doPendingFunctors的实现，单独拿出来做对照
+  class MutexLoop
+  {
+  public:
+    MutexLoop()
+        : wakeupFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          quit_(false),
+          wakeups_(0),
+          thread_(&MutexLoop::loop, this)
+    {
+    }
+
+    ~MutexLoop()
+    {
+      quit_ = true;
+      wakeup();
+      thread_.join();
+      ::close(wakeupFd_);
+    }
+
+    void queueInLoop(std::function<void()> cb)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending_.emplace_back(std::move(cb));
+      }
+      wakeup();
+    }
+
+    uint64_t wakeupCount() const { return wakeups_.load(); }
+
+  private:
+    void wakeup()
+    {
+      uint64_t one = 1;
+      wakeups_.fetch_add(1, std::memory_order_relaxed);
+      ssize_t n = ::write(wakeupFd_, &one, sizeof one);
+      (void)n;
+    }
+
+    void loop()
+    {
+      while (!quit_)
+      {
+        struct pollfd pfd = {wakeupFd_, POLLIN, 0};
+        ::poll(&pfd, 1, 1000);
+        uint64_t v;
+        ssize_t n = ::read(wakeupFd_, &v, sizeof v);
+        (void)n;
+        std::vector<std::function<void()>> functors;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          functors.swap(pending_);
+        }
+        for (const std::function<void()> &f : functors)
+        {
+          f();
+        }
+      }
+    }
+
+    int wakeupFd_;
+    std::atomic_bool quit_;
+    std::atomic<uint64_t> wakeups_;
+    std::mutex mutex_;
+    std::vector<std::function<void()>> pending_;
+    std::thread thread_;
+  };
+
+  template <typename Loop>
+  void runRound(const char *name, Loop *loop, int producers, int64_t total)
+  {
+    int64_t perThread = total / producers;
+    int64_t expected = perThread * producers;
+    g_done.store(0);
+    uint64_t wakeups0 = loop->wakeupCount();
+
+    Timestamp start(Timestamp::now());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i)
+    {
+      threads.emplace_back([loop, perThread]()
+                           {
+                             for (int64_t j = 0; j < perThread; ++j)
+                             {
+                               loop->queueInLoop([]()
+                                                 { g_done.fetch_add(1, std::memory_order_release); });
+                             } });
+    }
+    for (std::thread &t : threads)
+    {
+      t.join();
+    }
+    waitDone(expected);
+    Timestamp end(Timestamp::now());
+
+    double seconds = timeDifference(end, start);
+    uint64_t wakeups = loop->wakeupCount() - wakeups0;
+    printf("%-8s producers=%-3d %8.2f Mtasks/s  %8.1f ns/task  eventfd writes=%-9lu (%.4f per task)\n",
+           name, producers, expected / seconds / 1e6, seconds * 1e9 / expected,
+           static_cast<unsigned long>(wakeups), static_cast<double>(wakeups) / expected);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int64_t total = argc > 1 ? atol(argv[1]) : 1000000;
+  const int kProducers[] = {1, 2, 4, 8, 16, 32, 64};
+
+  {
+    EventLoopThread thread(EventLoopThread::ThreadInitCallback(), "bench-loop");
+    EventLoop *loop = thread.startLoop();
+    for (int p : kProducers)
+    {
+      runRound("mpsc", loop, p, total);
+    }
+  }
+  {
+    MutexLoop loop;
+    for (int p : kProducers)
+    {
+      runRound("mutex", &loop, p, total);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,241 @@
+// Buffer::readfd 基准测试
+// 对比 readv+64K栈空间 和 直接read进预先分配好的缓冲区：
+//   1. 吞吐阶段：每次系统调用平均读到多少字节
+//   2. 内存阶段：大量空闲连接各自收到一条小消息后，每个连接常驻多少内存
+//      pooled模式模拟TcpConnection：Buffer从BufferPool取内存，消息处理完立刻归还
+// 用法: read_bench [吞吐阶段总MiB，默认256] [连接数，默认5000]
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include "Buffer.h"
+#include "BufferPool.h"
+#include "Timestamp.h"
+
+namespace
+{
+  long residentBytes()
+  {
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp)
+    {
+      if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+      {
+        resident = 0;
+      }
+      fclose(fp);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+  }
+
+  enum Mode
+  {
+    kReadv,      // Buffer::readfd，默认1K的Buffer + 64K栈空间
+    kPlainSmall, // read进默认大小的Buffer(原来的做法)
+    kPlainLarge, // read进预先分配好的64K缓冲
+    kPooled,     // Buffer::readfd + BufferPool，读完即归还
+  };
+
+  const char *modeName(Mode mode)
+  {
+    switch (mode)
+    {
+    case kReadv:
+      return "readv+extrabuf";
+    case kPlainSmall:
+      return "read 1KiB";
+    case kPooled:
+      return "readv+pool";
+    default:
+      return "read 64KiB";
+    }
+  }
+
+  void writer(int fd, size_t total)
+  {
+    std::vector<char> chunk(256 * 1024, 'x');
+    size_t sent = 0;
+    while (sent < total)
+    {
+      size_t len = std::min(chunk.size(), total - sent);
+      ssize_t n = ::write(fd, chunk.data(), len);
+      if (n > 0)
+      {
+        sent += n;
+      }
+      else if (n < 0 && errno != EINTR)
+      {
+        break;
+      }
+    }
+    ::shutdown(fd, SHUT_WR);
+  }
+
+  void throughput(Mode mode, size_t total)
+  {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) < 0)
+    {
+      perror("socketpair");
+      exit(1);
+    }
+    // 写端用阻塞模式
+    int flags = 0;
+    ::ioctl(fds[1], FIONBIO, &flags);
+
+    std::thread t(writer, fds[1], total);
+
+    Buffer buffer;
+    std::vector<char> large(Buffer::kExtraBufSize);
+    size_t received = 0;
+    size_t syscalls = 0;
+    Timestamp start(Timestamp::now());
+    for (;;)
+    {
+      struct pollfd pfd = {fds[0], POLLIN, 0};
+      ::poll(&pfd, 1, -1);
+      ssize_t n;
+      int savedErrno = 0;
+      if (mode == kReadv)
+      {
+        n = buffer.readfd(fds[0], &savedErrno);
+      }
+      else if (mode == kPlainSmall)
+      {
+        buffer.ensureWriteableBytes(Buffer::kInitialSize);
+        n = ::read(fds[0], buffer.beginWrite(), buffer.writableBytes());
+      }
+      else
+      {
+        n = ::read(fds[0], large.data(), large.size());
+      }
+      ++syscalls;
+      if (n > 0)
+      {
+        received += n;
+        // 模拟上层把数据消费掉
+        buffer.retrieveAll();
+      }
+      else if (n == 0)
+      {
+        break;
+      }
+    }
+    Timestamp end(Timestamp::now());
+    t.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    double seconds = timeDifference(end, start);
+    printf("%-16s %8.1f bytes/syscall %8zu syscalls %8.1f MiB/s\n",
+           modeName(mode), static_cast<double>(received) / syscalls, syscalls,
+           static_cast<double>(received) / seconds / (1 << 20));
+  }
+
+  void memory(Mode mode, int conns)
+  {
+    std::vector<int> readers;
+    std::vector<int> writers;
+    for (int i = 0; i < conns; ++i)
+    {
+      int fds[2];
+      if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) < 0)
+      {
+        perror("socketpair");
+        break;
+      }
+      readers.push_back(fds[0]);
+      writers.push_back(fds[1]);
+    }
+
+    const char msg[200] = "ping";
+    for (int fd : writers)
+    {
+      if (::write(fd, msg, sizeof msg) < 0)
+      {
+        perror("write");
+      }
+    }
+
+    long before = residentBytes();
+    BufferPool pool;
+    std::vector<Buffer *> buffers;
+    std::vector<std::vector<char> *> larges;
+    for (int fd : readers)
+    {
+      int savedErrno = 0;
+      if (mode == kPlainLarge)
+      {
+        std::vector<char> *buf = new std::vector<char>(Buffer::kExtraBufSize);
+        if (::read(fd, buf->data(), buf->size()) < 0)
+        {
+          perror("read");
+        }
+        larges.push_back(buf);
+      }
+      else if (mode == kPooled)
+      {
+        Buffer *buf = new Buffer(&pool);
+        buf->readfd(fd, &savedErrno);
+        buf->retrieveAll();
+        buf->releaseIfEmpty();
+        buffers.push_back(buf);
+      }
+      else
+      {
+        Buffer *buf = new Buffer;
+        buf->readfd(fd, &savedErrno);
+        buffers.push_back(buf);
+      }
+    }
+    long after = residentBytes();
+    printf("%-16s %8.1f KiB resident per connection (%zu connections)\n",
+           modeName(mode), static_cast<double>(after - before) / readers.size() / 1024, readers.size());
+    if (mode == kPooled)
+    {
+      printf("%-16s hit rate %.3f, %zu bytes cached, %zu bytes in use\n", "",
+             pool.hitRate(), pool.stats().bytesCached, pool.stats().bytesInUse);
+    }
+
+    for (Buffer *buf : buffers)
+    {
+      delete buf;
+    }
+    for (std::vector<char> *buf : larges)
+    {
+      delete buf;
+    }
+    for (size_t i = 0; i < readers.size(); ++i)
+    {
+      ::close(readers[i]);
+      ::close(writers[i]);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  size_t totalMiB = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 256;
+  int conns = argc > 2 ? atoi(argv[2]) : 5000;
+
+  Mode modes[] = {kReadv, kPlainSmall, kPlainLarge};
+  for (Mode mode : modes)
+  {
+    throughput(mode, totalMiB << 20);
+  }
+  Mode memModes[] = {kReadv, kPooled, kPlainLarge};
+  for (Mode mode : memModes)
+  {
+    memory(mode, conns);
+  }
+  return 0;
+}
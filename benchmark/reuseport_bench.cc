@@ -0,0 +1,138 @@
+// 单个acceptor和每个loop一个SO_REUSEPORT acceptor的建连吞吐对比
+//   single:   baseLoop上一个acceptor，accept之后轮询交给ioLoop(queueInLoop跨线程)
+//   per-loop: 每个ioLoop一个监听socket，内核直接分配，连接在accept它的loop上建立
+// 若干客户端线程不停地connect再立刻close(SO_LINGER 0，避免TIME_WAIT耗尽端口)，
+// 统计每秒处理的连接数，以及连接在各个ioLoop之间的分布
+// 用法: reuseport_bench [最多的ioLoop数，默认CPU数] [每种配置的连接数，默认20000] [cpu分流 0/1，默认0]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9995;
+  const int kMaxLoops = 64;
+
+  std::atomic<int> g_closed(0);
+  std::atomic<int> g_perLoop[kMaxLoops];
+  std::vector<EventLoop *> g_loops;
+
+  void onConnection(const TcpConnectionPtr &conn)
+  {
+    if (conn->connected())
+    {
+      // g_loops在start之后就不再修改
+      for (size_t i = 0; i < g_loops.size(); ++i)
+      {
+        if (g_loops[i] == conn->getLoop())
+        {
+          ++g_perLoop[i];
+          break;
+        }
+      }
+    }
+    else
+    {
+      ++g_closed;
+    }
+  }
+
+  void connectLoop(int count)
+  {
+    InetAddress addr(kPort);
+    struct linger lin = {1, 0};
+    for (int i = 0; i < count; ++i)
+    {
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+      {
+        perror("connect");
+        exit(1);
+      }
+      ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+      ::close(fd);
+    }
+  }
+
+  void run(bool perLoop, int numLoops, int connections, bool cpuSteering)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "reuseport_bench",
+                     perLoop ? TcpServer::kReusePortPerLoop : TcpServer::kReusePort);
+    server.setThreadNum(numLoops);
+    server.setCpuSteering(cpuSteering);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                              { buf->retrieveAll(); });
+    g_closed = 0;
+    for (int i = 0; i < kMaxLoops; ++i)
+    {
+      g_perLoop[i] = 0;
+    }
+    // 线程池逐个启动ioLoop线程，初始化回调按顺序执行，用来登记loop的下标
+    g_loops.clear();
+    server.setThreadInitcallback([](EventLoop *ioLoop)
+                                 { g_loops.push_back(ioLoop); });
+    server.start();
+    std::thread client([&]()
+                       {
+      int clients = std::max(numLoops, 2);
+      Timestamp start(Timestamp::now());
+      std::vector<std::thread> threads;
+      for (int i = 0; i < clients; ++i)
+      {
+        threads.emplace_back(connectLoop, connections / clients);
+      }
+      for (std::thread &t : threads)
+      {
+        t.join();
+      }
+      int total = connections / clients * clients;
+      while (g_closed.load() < total)
+      {
+        std::this_thread::yield();
+      }
+      double seconds = timeDifference(Timestamp::now(), start);
+
+      int minCount = total;
+      int maxCount = 0;
+      for (int i = 0; i < numLoops; ++i)
+      {
+        minCount = std::min(minCount, g_perLoop[i].load());
+        maxCount = std::max(maxCount, g_perLoop[i].load());
+      }
+      printf("%-9s %5d %12.0f %10d %10d\n", perLoop ? "per-loop" : "single", numLoops,
+             total / seconds, minCount, maxCount);
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int maxLoops = argc > 1 ? atoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency());
+  int connections = argc > 2 ? atoi(argv[2]) : 20000;
+  bool cpuSteering = argc > 3 && atoi(argv[3]) != 0;
+  maxLoops = std::min(std::max(maxLoops, 1), kMaxLoops);
+  // 客户端用RST断开，服务端每个连接都会打一条handleError日志，这里不关心
+  Logger::setLogLevel(FATAL);
+
+  printf("%-9s %5s %12s %10s %10s\n", "acceptor", "loops", "conn/s", "min/loop", "max/loop");
+  for (int n = 1; n <= maxLoops; n *= 2)
+  {
+    run(false, n, connections, false);
+    run(true, n, connections, cpuSteering);
+  }
+  return 0;
+}
@@ -0,0 +1,160 @@
+// TcpConnection::sendFile 和缓冲send的对比，走loopback
+// 服务端在主线程的loop上，客户端线程发一个字节的请求，然后收完整个文件
+//   'b' : 服务端把文件read进std::string，再send(std::move(str))
+//   'f' : 服务端调用sendFile
+// 统计吞吐和服务端loop线程的CPU时间
+// 用法: sendfile_bench [最大文件MiB，默认1024] [每种大小的重复次数，默认3]
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include "TcpServer.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9990;
+
+  int g_fileFd = -1;
+  size_t g_fileSize = 0;
+  double g_serverCpu = 0; // 服务端线程消耗的CPU秒数
+
+  double threadCpuSeconds()
+  {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  }
+
+  double g_cpuStart = 0;
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    std::string req = buf->retrieveAllAsString();
+    for (char c : req)
+    {
+      g_cpuStart = threadCpuSeconds();
+      if (c == 'f')
+      {
+        conn->sendFile(g_fileFd, 0, g_fileSize);
+      }
+      else
+      {
+        std::string content(g_fileSize, '\0');
+        size_t done = 0;
+        while (done < g_fileSize)
+        {
+          ssize_t n = ::pread(g_fileFd, &content[done], g_fileSize - done, done);
+          if (n <= 0)
+          {
+            break;
+          }
+          done += n;
+        }
+        conn->send(std::move(content));
+      }
+    }
+  }
+
+  void onWriteComplete(const TcpConnectionPtr &)
+  {
+    g_serverCpu += threadCpuSeconds() - g_cpuStart;
+  }
+
+  // 客户端：请求rounds次，每次收满size个字节
+  void client(char mode, size_t size, int rounds, double *seconds)
+  {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(sockfd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+    {
+      perror("connect");
+      exit(1);
+    }
+    std::vector<char> buf(1 << 20);
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < rounds; ++i)
+    {
+      if (::write(sockfd, &mode, 1) != 1)
+      {
+        perror("write");
+        exit(1);
+      }
+      size_t received = 0;
+      while (received < size)
+      {
+        ssize_t n = ::read(sockfd, buf.data(), buf.size());
+        if (n <= 0)
+        {
+          perror("read");
+          exit(1);
+        }
+        received += n;
+      }
+    }
+    *seconds = timeDifference(Timestamp::now(), start);
+    ::close(sockfd);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  size_t maxMiB = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 1024;
+  int rounds = argc > 2 ? atoi(argv[2]) : 3;
+  Logger::setLogLevel(ERROR);
+
+  char path[] = "/tmp/sendfile_bench_XXXXXX";
+  g_fileFd = ::mkstemp(path);
+  ::unlink(path);
+
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort), "sendfile_bench");
+  server.setConnectionCallback([](const TcpConnectionPtr &) {});
+  server.setMessageCallback(onMessage);
+  server.setWriteCompleteCallback(onWriteComplete);
+  server.start();
+
+  std::thread runner([&]()
+                     {
+    printf("%10s %12s %10s %12s %10s\n", "size", "mode", "MiB/s", "server cpu", "cpu/GiB");
+    std::vector<char> block(1 << 20, 'x');
+    for (size_t mib = 1; mib <= maxMiB; mib *= 4)
+    {
+      while (g_fileSize < (mib << 20))
+      {
+        if (::write(g_fileFd, block.data(), block.size()) < 0)
+        {
+          perror("write file");
+          exit(1);
+        }
+        g_fileSize += block.size();
+      }
+      const char modes[] = {'b', 'f'};
+      for (char mode : modes)
+      {
+        g_serverCpu = 0;
+        double seconds = 0;
+        client(mode, g_fileSize, rounds, &seconds);
+        usleep(10 * 1000); // 等服务端的writeComplete回调统计完
+        double total = static_cast<double>(g_fileSize) * rounds;
+        printf("%8zuMiB %12s %10.1f %11.3fs %9.3fs\n", mib,
+               mode == 'f' ? "sendfile" : "buffered",
+               total / seconds / (1 << 20), g_serverCpu,
+               g_serverCpu / (total / (1 << 30)));
+      }
+    }
+    loop.quit(); });
+
+  loop.loop();
+  runner.join();
+  ::close(g_fileFd);
+  return 0;
+}
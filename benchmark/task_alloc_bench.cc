@@ -0,0 +1,144 @@
+// 统计跨线程投递任务时的内存分配次数
+// 任务的形状照抄TcpServer/TcpConnection里的调用点，分别用EventLoop::Functor(Task)
+// 和std::function包装，对比每个任务分配几次；Task路径稳态下应该为0，否则返回1
+// 用法: task_alloc_bench [每批任务数，默认1000]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+
+namespace
+{
+  std::atomic<int64_t> g_allocs(0);
+  std::atomic<int64_t> g_done(0);
+}
+
+void *operator new(size_t size)
+{
+  g_allocs.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size ? size : 1);
+  if (p == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+namespace
+{
+  // 模拟TcpConnection/TcpServer，只计数不干活
+  class FakeConn : public std::enable_shared_from_this<FakeConn>
+  {
+  public:
+    void connectEstablished() { g_done.fetch_add(1, std::memory_order_release); }
+    void sendStringInLoop(std::string &msg) { g_done.fetch_add(msg.empty() ? 0 : 1, std::memory_order_release); }
+  };
+  using FakeConnPtr = std::shared_ptr<FakeConn>;
+
+  class FakeServer
+  {
+  public:
+    void removeConnectionInLoop(const FakeConnPtr &) { g_done.fetch_add(1, std::memory_order_release); }
+  };
+
+  void onWriteComplete(const FakeConnPtr &) { g_done.fetch_add(1, std::memory_order_release); }
+
+  const int kWarmupBatches = 2;
+  const int kBatches = 100;
+
+  // 从另一个线程分批投递任务，每批等loop执行完再投下一批，模拟稳态
+  // make(i)返回一个可调用对象，Wrapper是装它的类型
+  template <typename Wrapper, typename Make>
+  double allocsPerTask(EventLoop *loop, int batchSize, Make make)
+  {
+    int64_t allocs = 0;
+    for (int batch = 0; batch < kWarmupBatches + kBatches; ++batch)
+    {
+      g_done.store(0);
+      int64_t before = g_allocs.load();
+      for (int i = 0; i < batchSize; ++i)
+      {
+        Wrapper w(make());
+        loop->queueInLoop(EventLoop::Functor(std::move(w)));
+      }
+      while (g_done.load(std::memory_order_acquire) < batchSize)
+      {
+        std::this_thread::yield();
+      }
+      if (batch >= kWarmupBatches)
+      {
+        allocs += g_allocs.load() - before;
+      }
+    }
+    return static_cast<double>(allocs) / (static_cast<int64_t>(batchSize) * kBatches);
+  }
+
+  bool report(const char *shape, size_t size, double task, double function)
+  {
+    printf("%-44s sizeof=%-3zu Task %.3f allocs/op   std::function %.3f allocs/op\n",
+           shape, size, task, function);
+    return task == 0.0;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int batchSize = argc > 1 ? atoi(argv[1]) : 1000;
+  bool ok = true;
+
+  EventLoopThread thread(EventLoopThread::ThreadInitCallback(), "alloc-loop");
+  EventLoop *loop = thread.startLoop();
+
+  FakeConnPtr conn = std::make_shared<FakeConn>();
+  FakeServer server;
+  std::function<void(const FakeConnPtr &)> writeCompleteCallback(onWriteComplete);
+
+  // TcpServer::newConnection -> connectEstablished
+  auto established = [&]()
+  { return std::bind(&FakeConn::connectEstablished, conn); };
+  ok &= report("bind(&Conn::connectEstablished, conn)", sizeof(established()),
+               allocsPerTask<Task>(loop, batchSize, established),
+               allocsPerTask<std::function<void()>>(loop, batchSize, established));
+
+  // TcpServer::removeConnection -> removeConnectionInLoop
+  auto removed = [&]()
+  { return std::bind(&FakeServer::removeConnectionInLoop, &server, conn); };
+  ok &= report("bind(&Server::removeConnectionInLoop, s, conn)", sizeof(removed()),
+               allocsPerTask<Task>(loop, batchSize, removed),
+               allocsPerTask<std::function<void()>>(loop, batchSize, removed));
+
+  // TcpConnection::handleWrite -> writeCompleteCallback_
+  auto writeComplete = [&]()
+  { return std::bind(writeCompleteCallback, conn); };
+  ok &= report("bind(writeCompleteCallback_, conn)", sizeof(writeComplete()),
+               allocsPerTask<Task>(loop, batchSize, writeComplete),
+               allocsPerTask<std::function<void()>>(loop, batchSize, writeComplete));
+
+  // TcpConnection::send跨线程，短消息走std::string的SSO，只统计任务本身
+  auto send = [&]()
+  { return std::bind(&FakeConn::sendStringInLoop, conn, std::string("ping")); };
+  ok &= report("bind(&Conn::sendStringInLoop, conn, string)", sizeof(send()),
+               allocsPerTask<Task>(loop, batchSize, send),
+               allocsPerTask<std::function<void()>>(loop, batchSize, send));
+
+  printf("%s\n", ok ? "OK: common paths do not allocate" : "FAIL: Task path allocated");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+// 时间轮基准测试：模拟大量空闲长连接的超时管理
+// 最后检查没有cancel就析构的Entry会从size()里扣掉，失败时返回1
+// 用法: timing_wheel_bench [连接数，默认1000000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <map>
+#include <vector>
+
+#include "TimingWheel.h"
+#include "Timestamp.h"
+
+namespace
+{
+  // 模拟嵌入在TcpConnection里的超时节点
+  struct FakeConn
+  {
+    TimingWheel::Entry idle;
+    int closed;
+  };
+
+  int64_t g_expired = 0;
+
+  void onExpire(void *arg)
+  {
+    static_cast<FakeConn *>(arg)->closed = 1;
+    ++g_expired;
+  }
+
+  // 当前进程常驻内存，单位字节
+  long residentBytes()
+  {
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp)
+    {
+      if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+      {
+        resident = 0;
+      }
+      fclose(fp);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+  }
+
+  double nsPerOp(Timestamp start, Timestamp end, size_t ops)
+  {
+    return timeDifference(end, start) * 1e9 / static_cast<double>(ops);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  size_t n = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 1000000;
+  const int kIdleTicks = 60;
+
+  printf("connections=%zu sizeof(Entry)=%zu sizeof(TimingWheel)=%zu\n",
+         n, sizeof(TimingWheel::Entry), sizeof(TimingWheel));
+
+  long rss0 = residentBytes();
+  std::vector<FakeConn> conns(n);
+  long rss1 = residentBytes();
+  TimingWheel wheel;
+
+  Timestamp start(Timestamp::now());
+  for (size_t i = 0; i < n; ++i)
+  {
+    conns[i].closed = 0;
+    conns[i].idle.setCallback(&onExpire, &conns[i]);
+    // 把到期时间分散开，避免全部落在同一个槽位
+    wheel.add(&conns[i].idle, kIdleTicks + i % 300);
+  }
+  Timestamp end(Timestamp::now());
+  printf("add:      %8.1f ns/op, rss of %zu conns incl. entries %.1f MiB\n",
+         nsPerOp(start, end, n), n, static_cast<double>(rss1 - rss0) / (1 << 20));
+
+  // 每次读写都刷新一次，模拟活跃连接
+  const size_t kRefreshRounds = 5;
+  start = Timestamp::now();
+  for (size_t round = 0; round < kRefreshRounds; ++round)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      wheel.refresh(&conns[i].idle, kIdleTicks);
+    }
+  }
+  end = Timestamp::now();
+  printf("refresh:  %8.1f ns/op\n", nsPerOp(start, end, n * kRefreshRounds));
+
+  // 推进到全部到期，统计每个tick的平均处理成本
+  start = Timestamp::now();
+  size_t ticks = 0;
+  while (wheel.size() > 0)
+  {
+    wheel.tick();
+    ++ticks;
+  }
+  end = Timestamp::now();
+  printf("expire:   %8.1f ns/conn over %zu ticks, expired=%ld\n",
+         nsPerOp(start, end, n), ticks, static_cast<long>(g_expired));
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    wheel.add(&conns[i].idle, kIdleTicks);
+  }
+  start = Timestamp::now();
+  for (size_t i = 0; i < n; ++i)
+  {
+    wheel.cancel(&conns[i].idle);
+  }
+  end = Timestamp::now();
+  printf("cancel:   %8.1f ns/op\n", nsPerOp(start, end, n));
+
+  // 对照组：平衡树(和TimerQueue同样的做法)，刷新需要删除再插入
+  std::multimap<int64_t, FakeConn *> tree;
+  std::vector<std::multimap<int64_t, FakeConn *>::iterator> handles(n);
+  long rss2 = residentBytes();
+  start = Timestamp::now();
+  for (size_t i = 0; i < n; ++i)
+  {
+    handles[i] = tree.insert(std::make_pair(static_cast<int64_t>(kIdleTicks + i % 300), &conns[i]));
+  }
+  end = Timestamp::now();
+  long rss3 = residentBytes();
+  printf("rbtree add:     %8.1f ns/op, extra rss %.1f MiB\n",
+         nsPerOp(start, end, n), static_cast<double>(rss3 - rss2) / (1 << 20));
+  start = Timestamp::now();
+  for (size_t i = 0; i < n; ++i)
+  {
+    tree.erase(handles[i]);
+    handles[i] = tree.insert(std::make_pair(static_cast<int64_t>(kIdleTicks * 2), &conns[i]));
+  }
+  end = Timestamp::now();
+  printf("rbtree refresh: %8.1f ns/op\n", nsPerOp(start, end, n));
+
+  {
+    TimingWheel small;
+    FakeConn kept;
+    kept.idle.setCallback(&onExpire, &kept);
+    small.add(&kept.idle, kIdleTicks);
+    {
+      FakeConn dropped;
+      dropped.idle.setCallback(&onExpire, &dropped);
+      small.add(&dropped.idle, kIdleTicks);
+    }
+    if (small.size() != 1)
+    {
+      printf("FAIL: size()=%zu after destroying an armed entry, expected 1\n", small.size());
+      return 1;
+    }
+  }
+  printf("destroy armed entry: ok\n");
+  return 0;
+}
@@ -0,0 +1,179 @@
+// Tracer的记录开销和dump
+//   1. 空span在关闭和打开记录时各自的耗时
+//   2. loopback pingpong，对比打开和关闭记录时的往返次数
+//   3. 打开记录压测一会，给自己发SIGUSR2，检查后台线程dump出的JSON里有poll、
+//      pendingFunctor和带连接名的读事件，失败时返回1
+// 用法: trace_bench [每种配置的往返次数，默认50000] [dump的路径，默认/tmp/trace_bench.json]
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "TcpServer.h"
+#include "Tracer.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9986;
+  const size_t kMessageSize = 64;
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  void pingpong(int rounds)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+    {
+      perror("connect");
+      exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    char message[kMessageSize] = {0};
+    char reply[kMessageSize];
+    for (int r = 0; r < rounds; ++r)
+    {
+      if (::write(fd, message, sizeof message) != static_cast<ssize_t>(sizeof message))
+      {
+        perror("write");
+        exit(1);
+      }
+      size_t got = 0;
+      while (got < sizeof reply)
+      {
+        ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+        if (n <= 0)
+        {
+          perror("read");
+          exit(1);
+        }
+        got += n;
+      }
+    }
+    ::close(fd);
+  }
+
+  void spanCost(bool enabled)
+  {
+    Tracer::setEnabled(enabled);
+    const int kIterations = 10000000;
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < kIterations; ++i)
+    {
+      TraceSpan span("bench", i & 1023);
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    Tracer::setEnabled(false);
+    printf("span %-8s %8.2f ns\n", enabled ? "on" : "off", seconds * 1e9 / kIterations);
+  }
+
+  // 返回pingpong的往返次数/秒
+  double echo(bool traced, int rounds)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "trace_bench", TcpServer::kReusePort);
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    server.start();
+    Tracer::setEnabled(traced);
+
+    double rate = 0;
+    std::thread client([&]()
+                       {
+      Timestamp start(Timestamp::now());
+      pingpong(rounds);
+      rate = rounds / timeDifference(Timestamp::now(), start);
+      loop.quit(); });
+
+    loop.loop();
+    client.join();
+    Tracer::setEnabled(false);
+    printf("trace %-8s %10.0f rtt/s\n", traced ? "on" : "off", rate);
+    return rate;
+  }
+
+  bool dumpBySignal(const std::string &path, int rounds)
+  {
+    ::unlink(path.c_str());
+    if (!Tracer::dumpOnSignal(SIGUSR2, path))
+    {
+      printf("FAIL: could not install the signal handler\n");
+      return false;
+    }
+    echo(true, rounds);
+    ::raise(SIGUSR2);
+
+    // 后台线程写完文件之后才能读
+    std::string text;
+    for (int i = 0; i < 500; ++i)
+    {
+      std::ifstream in(path.c_str());
+      std::stringstream ss;
+      ss << in.rdbuf();
+      text = ss.str();
+      if (text.size() > 3 && text.compare(text.size() - 3, 3, "]}\n") == 0)
+      {
+        break;
+      }
+      ::usleep(10 * 1000);
+    }
+    printf("dump: %zu bytes in %s\n", text.size(), path.c_str());
+
+    bool ok = true;
+    const char *kExpected[] = {"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[",
+                               "\"name\":\"poll\",\"ph\":\"X\"",
+                               "\"name\":\"functor\",\"ph\":\"X\"",
+                               "\"name\":\"read\",\"ph\":\"X\"",
+                               "\"conn\":\"trace_bench-",
+                               "\"name\":\"thread_name\""};
+    for (const char *expected : kExpected)
+    {
+      if (text.find(expected) == std::string::npos)
+      {
+        printf("FAIL: %s not found in the dump\n", expected);
+        ok = false;
+      }
+    }
+    if (text.size() < 3 || text.compare(text.size() - 3, 3, "]}\n") != 0)
+    {
+      printf("FAIL: dump was not completed\n");
+      ok = false;
+    }
+    return ok;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 50000;
+  std::string path = argc > 2 ? argv[2] : "/tmp/trace_bench.json";
+  Logger::setLogLevel(ERROR);
+
+  spanCost(false);
+  spanCost(true);
+  echo(false, rounds);
+  echo(true, rounds);
+  echo(false, rounds);
+  echo(true, rounds);
+  if (!dumpBySignal(path, rounds / 10))
+  {
+    return 1;
+  }
+  printf("signal dump: ok\n");
+  return 0;
+}
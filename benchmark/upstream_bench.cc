@@ -0,0 +1,206 @@
+// 上游连接池和每个请求新建连接的对比，走loopback
+// 上游是一个echo服务，"代理"在另一个loop上通过UpstreamPool发请求：
+// 若干条请求链并发，每条链发64字节等回包后归还连接，再发下一个请求
+//   pooled:      连接用完放回空闲列表，稳态下不再connect
+//   per-request: setMaxIdle(0)，每个请求都新建连接、用完关闭
+// 另外用TcpClient连一个不存在的端口，检查Connector按退避重试并在服务起来后连上，失败时返回1
+// 用法: upstream_bench [请求数，默认5000] [并发的请求链，默认8]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "UpstreamPool.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+namespace
+{
+  const uint16_t kPort = 9990;
+  const uint16_t kLatePort = 9989;
+  const size_t kMessageSize = 64;
+
+  // 在loop线程里执行f并等它完成
+  template <typename F>
+  void runSync(EventLoop *loop, F f)
+  {
+    std::promise<void> done;
+    loop->runInLoop([&]()
+                    {
+      f();
+      done.set_value(); });
+    done.get_future().wait();
+  }
+
+  void onEcho(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+  {
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+  }
+
+  // 在loop线程里调用，TcpServer也要在这个线程里析构
+  std::unique_ptr<TcpServer> startEchoServer(EventLoop *loop, uint16_t port)
+  {
+    std::unique_ptr<TcpServer> server(new TcpServer(loop, InetAddress(port), "upstream_bench", TcpServer::kReusePort));
+    server->setConnectionCallback([](const TcpConnectionPtr &) {});
+    server->setMessageCallback(onEcho);
+    server->start();
+    return server;
+  }
+
+  // 只在代理loop线程里访问
+  struct Bench
+  {
+    UpstreamPool *pool;
+    int remaining;
+    int chains;
+    std::vector<double> latencies;
+    std::promise<void> done;
+  };
+
+  void issue(Bench *bench)
+  {
+    if (bench->remaining == 0)
+    {
+      if (--bench->chains == 0)
+      {
+        bench->done.set_value();
+      }
+      return;
+    }
+    --bench->remaining;
+    Timestamp start(Timestamp::now());
+    bench->pool->acquire([bench, start](const TcpConnectionPtr &conn)
+                         {
+      if (!conn)
+      {
+        fprintf(stderr, "FAIL: upstream connect failed\n");
+        exit(1);
+      }
+      conn->setMessageCallback([bench, start](const TcpConnectionPtr &c, Buffer *buf, Timestamp)
+                               {
+        if (buf->readableBytes() < kMessageSize)
+        {
+          return;
+        }
+        buf->retrieve(kMessageSize);
+        bench->latencies.push_back(timeDifference(Timestamp::now(), start) * 1e6);
+        bench->pool->release(c);
+        issue(bench); });
+      char message[kMessageSize] = {0};
+      conn->send(message, sizeof message); });
+  }
+
+  void run(EventLoop *proxyLoop, bool pooled, int requests, int chains)
+  {
+    Bench bench;
+    bench.remaining = requests;
+    bench.chains = chains;
+    bench.latencies.reserve(requests);
+    std::unique_ptr<UpstreamPool> pool;
+    std::future<void> done = bench.done.get_future();
+
+    Timestamp start(Timestamp::now());
+    proxyLoop->runInLoop([&]()
+                         {
+      pool.reset(new UpstreamPool(proxyLoop, InetAddress(kPort), pooled ? "pooled" : "per-request"));
+      pool->setMaxIdle(pooled ? chains : 0);
+      bench.pool = pool.get();
+      for (int i = 0; i < chains; ++i)
+      {
+        issue(&bench);
+      } });
+    done.wait();
+    double seconds = timeDifference(Timestamp::now(), start);
+
+    // 连接池只能在自己的loop里读取和销毁
+    uint64_t connects = 0;
+    uint64_t reused = 0;
+    runSync(proxyLoop, [&]()
+            {
+      connects = pool->connects();
+      reused = pool->reused();
+      pool.reset(); });
+
+    std::sort(bench.latencies.begin(), bench.latencies.end());
+    double sum = 0;
+    for (double l : bench.latencies)
+    {
+      sum += l;
+    }
+    printf("%-12s %10.0f %10.1f %10.1f %10lu %10lu\n", pooled ? "pooled" : "per-request",
+           requests / seconds, sum / bench.latencies.size(),
+           bench.latencies[bench.latencies.size() * 99 / 100],
+           (unsigned long)connects, (unsigned long)reused);
+  }
+
+  // 服务还没起来时Connector重试，起来之后TcpClient连上并能收发
+  bool retryCheck(EventLoop *proxyLoop, EventLoop *serverLoop)
+  {
+    std::promise<void> echoed;
+    std::atomic<bool> once(false);
+    std::unique_ptr<TcpClient> client(new TcpClient(proxyLoop, InetAddress(kLatePort), "late"));
+    client->setConnectionCallback([](const TcpConnectionPtr &conn)
+                                  {
+      if (conn->connected())
+      {
+        conn->send("ping");
+      } });
+    client->setMessageCallback([&](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                               {
+      if (buf->readableBytes() >= 4 && !once.exchange(true))
+      {
+        echoed.set_value();
+      }
+      buf->retrieveAll(); });
+    client->connect();
+
+    // 第一次connect被拒绝之后500ms重试，这时服务已经起来了
+    ::usleep(200 * 1000);
+    std::unique_ptr<TcpServer> server;
+    runSync(serverLoop, [&]()
+            { server = startEchoServer(serverLoop, kLatePort); });
+
+    std::future<void> future = echoed.get_future();
+    bool ok = future.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+    printf("connector retry: %s\n", ok ? "ok" : "FAIL, no echo within 5s");
+
+    // TcpClient和TcpServer都在各自的loop线程里析构
+    runSync(proxyLoop, [&]()
+            { client.reset(); });
+    runSync(serverLoop, [&]()
+            { server.reset(); });
+    return ok;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int requests = argc > 1 ? atoi(argv[1]) : 5000;
+  int chains = argc > 2 ? atoi(argv[2]) : 8;
+  Logger::setLogLevel(ERROR);
+
+  EventLoopThread serverThread(EventLoopThread::ThreadInitCallback(), "upstream");
+  EventLoop *serverLoop = serverThread.startLoop();
+  EventLoopThread proxyThread(EventLoopThread::ThreadInitCallback(), "proxy");
+  EventLoop *proxyLoop = proxyThread.startLoop();
+
+  std::unique_ptr<TcpServer> server;
+  runSync(serverLoop, [&]()
+          { server = startEchoServer(serverLoop, kPort); });
+
+  printf("%-12s %10s %10s %10s %10s %10s\n", "mode", "req/s", "avg us", "p99 us", "connects", "reused");
+  run(proxyLoop, true, requests, chains);
+  run(proxyLoop, false, requests, chains);
+
+  bool ok = retryCheck(proxyLoop, serverLoop);
+  runSync(serverLoop, [&]()
+          { server.reset(); });
+  return ok ? 0 : 1;
+}